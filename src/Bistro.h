@@ -1,5 +1,6 @@
 #pragma once
 
+#include "shared/AssetCache.h"
 #include "shared/Scene/MergeUtil.h"
 #include "shared/Scene/Scene.h"
 #include "shared/Scene/VtxData.h"
@@ -13,68 +14,326 @@
 #define fileNameCachedHierarchy ".cache/ch08_bistro.scene"
 #endif
 
-void loadBistro(MeshData& meshData, Scene& scene) {
-  if (!isMeshDataValid(fileNameCachedMeshes) || !isMeshHierarchyValid(fileNameCachedHierarchy) ||
-      !isMeshMaterialsValid(fileNameCachedMaterials)) {
-    printf("No cached mesh data found. Precaching...\n\n");
-
-    MeshData meshData_Exterior;
-    MeshData meshData_Interior;
-    Scene ourScene_Exterior;
-    Scene ourScene_Interior;
-
-    // don't generate LODs because meshoptimizer fails on the Bistro mesh
-    loadMeshFile("../../data/bistro/Exterior/exterior.obj", meshData_Exterior, ourScene_Exterior, false);
-    loadMeshFile("../../data/bistro/Interior/interior.obj", meshData_Interior, ourScene_Interior, false);
-
-    // merge some meshes
-    printf("[Unmerged] scene items: %u\n", (uint32_t)ourScene_Exterior.hierarchy.size());
-    mergeNodesWithMaterial(ourScene_Exterior, meshData_Exterior, "Foliage_Linde_Tree_Large_Orange_Leaves");
-    printf("[Merged orange leaves] scene items: %u\n", (uint32_t)ourScene_Exterior.hierarchy.size());
-    mergeNodesWithMaterial(ourScene_Exterior, meshData_Exterior, "Foliage_Linde_Tree_Large_Green_Leaves");
-    printf("[Merged green leaves]  scene items: %u\n", (uint32_t)ourScene_Exterior.hierarchy.size());
-    mergeNodesWithMaterial(ourScene_Exterior, meshData_Exterior, "Foliage_Linde_Tree_Large_Trunk");
-    printf("[Merged trunk]  scene items: %u\n", (uint32_t)ourScene_Exterior.hierarchy.size());
+#if !defined(fileNameCacheManifest)
+#define fileNameCacheManifest ".cache/assets.manifest"
+#endif
+
+// bump when the conversion or the merging code changes, the cached files are rebuilt then
+constexpr uint32_t kBistroCacheVersion = 9;
+
+// world-space cell size of the static batching, in meters
+constexpr float kBistroBatchCellSize = 32.0f;
+
+uint64_t getBistroCacheParams(uint32_t stage) {
+  const uint32_t params[] = {
+    kBistroCacheVersion,
+    stage,
+    DEMO_TEXTURE_MAX_SIZE,
+#if defined(BISTRO_QUANTIZE_POSITIONS)
+    1,
+#else
+    0,
+#endif
+    (uint32_t)kBistroBatchCellSize,
+#if defined(BISTRO_COMPRESS_MESHES)
+    1,
+#else
+    0,
+#endif
+  };
+  // the converted materials reference the textures in the cache folder
+  return hashBytes(DEMO_TEXTURE_CACHE_FOLDER, strlen(DEMO_TEXTURE_CACHE_FOLDER), hashBytes(params, sizeof(params)));
+}
+
+// the converted .obj file before merging: .meshes, .materials and .scene files next to the final cache files
+std::vector<std::string> getCachedMeshFileNames(const char* objFile) {
+  const std::string prefix = std::filesystem::path(fileNameCachedMeshes).replace_extension().string() + "_" +
+                             std::filesystem::path(objFile).stem().string();
+  return { prefix + ".meshes", prefix + ".materials", prefix + ".scene" };
+}
+
+// .obj and .mtl files
+std::vector<std::string> getMeshFileSources(const char* objFile) {
+  return { objFile, std::filesystem::path(objFile).replace_extension(".mtl").string() };
+}
+
+bool isCachedMeshFileUpToDate(AssetCacheManifest& cache, const char* objFile) {
+  const std::vector<std::string> files = getCachedMeshFileNames(objFile);
+  const std::vector<std::string> sources = getMeshFileSources(objFile);
+  for (const std::string& f : files)
+    if (!isAssetUpToDate(cache, f, getBistroCacheParams(0), sources))
+      return false;
+  return isMeshDataValid(files[0].c_str());
+}
+
+// convert one .obj file or load its cached conversion if the sources did not change
+void loadCachedMeshFile(AssetCacheManifest& cache, const char* objFile, MeshData& meshData, Scene& scene) {
+  const std::vector<std::string> files = getCachedMeshFileNames(objFile);
+
+  if (isCachedMeshFileUpToDate(cache, objFile)) {
+    printf("Loading cached '%s'...\n", objFile);
+    loadMeshData(files[0].c_str(), meshData);
+    loadMeshDataMaterials(files[1].c_str(), meshData);
+    loadScene(files[2].c_str(), scene);
+    return;
+  }
+
+  // the LOD chains are generated in parallel across meshes, only the stale textures are converted
+  loadMeshFile(objFile, meshData, scene, true, &cache);
+
+  recalculateBoundingVolumes(meshData);
+  saveMeshData(files[0].c_str(), meshData);
+  saveMeshDataMaterials(files[1].c_str(), meshData);
+  saveScene(files[2].c_str(), scene);
+
+  for (const std::string& f : files)
+    updateAsset(cache, f, getBistroCacheParams(0), getMeshFileSources(objFile));
+}
+
+// Every cached file is keyed on the content hashes of its sources and the conversion parameters (see AssetCache.h):
+//  - textures on their images and opacity masks
+//  - converted .obj files on the .obj and .mtl files
+//  - the final merged scene on the converted .obj files
+// Only the stale pieces are rebuilt, e.g. a single edited texture does not trigger any mesh conversion
+// What goes into the cached scene: the converted .obj files are merged in this order, and in every scene the nodes of each material
+// in mergedMaterials are merged into one mesh (see mergeNodesWithMaterial()). The nodes of the materials in dynamicMaterials are
+// marked as dynamic: they are animated at runtime and kept out of the static batches. Paths are relative to the working directory
+struct BistroManifest {
+  std::vector<std::string> objFiles;
+  std::vector<std::string> mergedMaterials;
+  std::vector<std::string> dynamicMaterials;
+};
+
+BistroManifest getDefaultBistroManifest() {
+  return {
+    .objFiles = {
+        "../../data/bistro/Exterior/exterior.obj",
+        "../../data/bistro/Interior/interior.obj",
+    },
+    .mergedMaterials = {
+        "Foliage_Linde_Tree_Large_Orange_Leaves",
+        "Foliage_Linde_Tree_Large_Green_Leaves",
+        "Foliage_Linde_Tree_Large_Trunk",
+    },
+  };
+}
+
+// Text manifest, one entry per line, empty lines and lines starting with '#' are ignored:
+//   obj <path to .obj>
+//   merge-material <material name>
+//   dynamic-material <material name>
+bool loadBistroManifest(const char* fileName, BistroManifest& m) {
+  FILE* f = fopen(fileName, "r");
+
+  if (!f) {
+    printf("Cannot open the manifest %s\n", fileName);
+    return false;
+  }
+
+  SCOPE_EXIT {
+    fclose(f);
+  };
+
+  m = {};
+
+  char buf[1024];
+  uint32_t lineNo = 0;
+
+  while (fgets(buf, sizeof(buf), f)) {
+    lineNo++;
+
+    std::string line(buf);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r' || line.back() == ' '))
+      line.pop_back();
+
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    if (line.starts_with("obj ")) {
+      m.objFiles.push_back(line.substr(4));
+    } else if (line.starts_with("merge-material ")) {
+      m.mergedMaterials.push_back(line.substr(15));
+    } else if (line.starts_with("dynamic-material ")) {
+      m.dynamicMaterials.push_back(line.substr(17));
+    } else {
+      printf("%s(%u): unknown entry '%s'\n", fileName, lineNo, line.c_str());
+      return false;
+    }
+  }
+
+  if (m.objFiles.empty()) {
+    printf("The manifest %s has no obj entries\n", fileName);
+    return false;
+  }
+
+  return true;
+}
+
+// the merged scene depends on the conversion parameters and on the merged and the dynamic materials
+uint64_t getBistroMergeParams(const BistroManifest& manifest) {
+  uint64_t hash = getBistroCacheParams(1);
+
+  for (const std::string& name : manifest.mergedMaterials)
+    hash = hashBytes(name.c_str(), name.size() + 1, hash);
+
+  // a separator, so moving a name from one list to the other changes the hash
+  const uint32_t numMerged = (uint32_t)manifest.mergedMaterials.size();
+  hash = hashBytes(&numMerged, sizeof(numMerged), hash);
+
+  for (const std::string& name : manifest.dynamicMaterials)
+    hash = hashBytes(name.c_str(), name.size() + 1, hash);
+
+  return hash;
+}
+
+// Rebuild the stale parts of the cache. With dryRun nothing is converted and the stale files are only listed.
+// Returns true if the cache was up to date
+bool precacheBistro(const BistroManifest& manifest = getDefaultBistroManifest(), bool dryRun = false) {
+  AssetCacheManifest cache;
+  loadAssetCacheManifest(fileNameCacheManifest, cache);
+
+  const uint32_t numStaleTextures = refreshCachedTextures(cache, dryRun);
+
+  if (numStaleTextures && !dryRun)
+    printf("Reconverted %u stale textures\n", numStaleTextures);
+
+  std::vector<std::string> mergedSources;
+  bool isUpToDate = true;
+
+  for (const std::string& obj : manifest.objFiles) {
+    mergeVectors(mergedSources, getCachedMeshFileNames(obj.c_str()));
+    if (!isCachedMeshFileUpToDate(cache, obj.c_str())) {
+      if (dryRun)
+        printf("Stale: %s (textures referenced by it are checked only when it is converted)\n", obj.c_str());
+      isUpToDate = false;
+    }
+  }
+
+  const std::vector<std::string> cachedFiles = { fileNameCachedMeshes, fileNameCachedMaterials, fileNameCachedHierarchy };
+  const uint64_t mergeParams = getBistroMergeParams(manifest);
+
+  bool isMergedUpToDate = isMeshDataValid(fileNameCachedMeshes) && isMeshHierarchyValid(fileNameCachedHierarchy) &&
+                          isMeshMaterialsValid(fileNameCachedMaterials);
+
+  for (const std::string& f : cachedFiles)
+    isMergedUpToDate = isMergedUpToDate && isAssetUpToDate(cache, f, mergeParams, mergedSources);
+
+  if (dryRun) {
+    for (const std::string& f : cachedFiles)
+      printf("%s: %s\n", isUpToDate && isMergedUpToDate ? "Up to date" : "Stale", f.c_str());
+
+    return !numStaleTextures && isUpToDate && isMergedUpToDate;
+  }
+
+  if (!isUpToDate || !isMergedUpToDate) {
+    printf("Cached mesh data is missing or stale. Precaching...\n\n");
+
+    const size_t numScenes = manifest.objFiles.size();
+
+    std::vector<MeshData> meshDatas(numScenes);
+    std::vector<Scene> scenes(numScenes);
+
+    for (size_t i = 0; i != numScenes; i++) {
+      loadCachedMeshFile(cache, manifest.objFiles[i].c_str(), meshDatas[i], scenes[i]);
+
+      // merge some meshes
+      printf("[Unmerged] scene items: %u\n", (uint32_t)scenes[i].hierarchy.size());
+      for (const std::string& name : manifest.mergedMaterials) {
+        mergeNodesWithMaterial(scenes[i], meshDatas[i], name);
+        printf("[Merged %s] scene items: %u\n", name.c_str(), (uint32_t)scenes[i].hierarchy.size());
+      }
+
+      // the dynamic nodes survive all the merging below as separate nodes
+      for (const std::string& name : manifest.dynamicMaterials) {
+        const auto it = std::find(scenes[i].materialNames.begin(), scenes[i].materialNames.end(), name);
+        if (it == scenes[i].materialNames.end())
+          continue;
+        for (uint32_t node : getNodesWithMaterial(scenes[i], (uint32_t)std::distance(scenes[i].materialNames.begin(), it)))
+          setNodeDynamic(scenes[i], node);
+      }
+    }
+
+    std::vector<Scene*> scenePtrs;
+    std::vector<MeshData*> meshDataPtrs;
+    std::vector<uint32_t> meshCounts;
+    std::vector<std::vector<Material>*> materialLists;
+    std::vector<std::vector<std::string>*> textureLists;
+
+    for (size_t i = 0; i != numScenes; i++) {
+      scenePtrs.push_back(&scenes[i]);
+      meshDataPtrs.push_back(&meshDatas[i]);
+      meshCounts.push_back((uint32_t)meshDatas[i].meshes.size());
+      materialLists.push_back(&meshDatas[i].materials);
+      textureLists.push_back(&meshDatas[i].textureFiles);
+    }
 
     // merge everything into one big scene
     MeshData meshData;
     Scene ourScene;
 
-    mergeScenes(
-        ourScene,
-        {
-            &ourScene_Exterior,
-            &ourScene_Interior,
-        },
-        {},
-        {
-            static_cast<uint32_t>(meshData_Exterior.meshes.size()),
-            static_cast<uint32_t>(meshData_Interior.meshes.size()),
-        });
-    mergeMeshData(meshData, { &meshData_Exterior, &meshData_Interior });
-    mergeMaterialLists(
-        {
-            &meshData_Exterior.materials,
-            &meshData_Interior.materials,
-        },
-        {
-            &meshData_Exterior.textureFiles,
-            &meshData_Interior.textureFiles,
-        },
-        meshData.materials, meshData.textureFiles);
+    mergeScenes(ourScene, scenePtrs, {}, meshCounts);
+    // identical materials of all scenes are collapsed, the meshes and the nodes are remapped to the unique ones
+    const std::vector<uint32_t> materialRemap = mergeMaterialLists(materialLists, textureLists, meshData.materials, meshData.textureFiles);
+    mergeMeshData(meshData, meshDataPtrs, materialRemap);
+    remapSceneMaterials(ourScene, materialRemap);
 
     ourScene.localTransform[0] = glm::scale(vec3(0.01f)); // scale the Bistro
     markAsChanged(ourScene, 0);
 
-    recalculateBoundingBoxes(meshData);
+    // identical meshes are drawn as instances of one mesh
+    deduplicateMeshes(ourScene, meshData);
+
+    // the remaining unique meshes of the static nodes are baked into one mesh per material and grid cell, the boxes are regenerated
+    batchStaticMeshes(ourScene, meshData, kBistroBatchCellSize);
 
+    // clusters for per-meshlet culling, the merged foliage meshes are split into small pieces
+    generateMeshlets(meshData);
+
+#if defined(BISTRO_QUANTIZE_POSITIONS)
+    // 16-bit positions relative to the mesh bounds, prints the error report
+    quantizeMeshPositions(meshData);
+#endif
+
+    // spheres and OBBs for culling and LOD selection, computed once for the final meshes
+    recalculateBoundingVolumes(meshData);
+
+#if defined(BISTRO_COMPRESS_MESHES)
+    // smaller cache and less I/O on cold loads, VKMesh11 decodes every mesh right before its upload
+    saveMeshDataCompressed(fileNameCachedMeshes, meshData);
+#else
     saveMeshData(fileNameCachedMeshes, meshData);
+#endif
     saveMeshDataMaterials(fileNameCachedMaterials, meshData);
     saveScene(fileNameCachedHierarchy, ourScene);
+
+    for (const std::string& f : cachedFiles)
+      updateAsset(cache, f, mergeParams, mergedSources);
   }
 
-  const MeshFileHeader header = loadMeshData(fileNameCachedMeshes, meshData);
+  saveAssetCacheManifest(fileNameCacheManifest, cache);
+
+  return !numStaleTextures && isUpToDate && isMergedUpToDate;
+}
+
+void loadBistro(MeshData& meshData, Scene& scene) {
+  precacheBistro();
+
+  loadMeshData(fileNameCachedMeshes, meshData);
   loadMeshDataMaterials(fileNameCachedMaterials, meshData);
 
   loadScene(fileNameCachedHierarchy, scene);
-}
\ No newline at end of file
+}
+
+// memory-maps the cached geometry instead of copying it (a compressed cache stays encoded and is decoded later by VKMesh11); only the
+// materials are loaded into `materials`
+void loadBistro(MeshDataView& meshData, MeshData& materials, Scene& scene) {
+  precacheBistro();
+
+  if (!loadMeshDataView(fileNameCachedMeshes, meshData)) {
+    printf("Cannot map the mesh file %s\n", fileNameCachedMeshes);
+    exit(EXIT_FAILURE);
+  }
+  loadMeshDataMaterials(fileNameCachedMaterials, materials);
+
+  loadScene(fileNameCachedHierarchy, scene);
+}
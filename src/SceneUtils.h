@@ -1,8 +1,12 @@
 #pragma once
 
 #include <algorithm>
-#include <execution>
+#include <atomic>
 #include <filesystem>
+#include <numeric>
+
+#include <taskflow/taskflow.hpp>
+#include <taskflow/algorithm/for_each.hpp>
 
 #include <gl_format.h>
 #include <vkformat_enum.h>
@@ -12,6 +16,7 @@
 #include "stb_image.h"
 #include "stb_image_resize2.h"
 
+#include "shared/AssetCache.h"
 #include "shared/UtilsGLTF.h"
 #include "VKMesh08.h"
 
@@ -21,6 +26,18 @@
 #define DEMO_TEXTURE_CACHE_FOLDER ".cache/out_textures/"
 #endif
 
+// fn(i) for every i in [0, count) on getNumConversionThreads() worker threads
+template <typename Fn>
+void parallelFor(uint32_t count, Fn &&fn)
+{
+	tf::Executor executor(getNumConversionThreads());
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, count, 1u, [&fn](uint32_t i) { fn(i); });
+
+	executor.run(taskflow).wait();
+}
+
 // find a file in directory which "almost" coincides with the origFile (their lowercase versions coincide)
 std::string findSubstitute(const std::string &origFile)
 {
@@ -47,25 +64,22 @@ std::string fixTextureFile(const std::string &file)
 	return std::filesystem::exists(file) ? file : findSubstitute(file);
 }
 
-std::string convertTexture(
-	const std::string &file, const std::string &basePath, std::unordered_map<std::string, uint32_t> &opacityMapIndices,
-	const std::vector<std::string> &opacityMaps)
+// bump when the output of convertTextureFile() changes, all cached textures are rebuilt then
+constexpr uint32_t kTextureConversionVersion = 1;
+
+// the conversion parameters of the cached textures, see AssetCache.h
+inline uint64_t getTextureCacheParams()
+{
+	const uint32_t params[] = {kTextureConversionVersion, DEMO_TEXTURE_MAX_SIZE};
+	return hashBytes(params, sizeof(params));
+}
+
+// Rescale and compress a texture to BC7. If opacityMapFile is not empty, the opacity mask is stored in the alpha channel
+void convertTextureFile(const std::string &srcFile, const std::string &opacityMapFile, const std::string &newFile)
 {
 	const int maxNewWidth = DEMO_TEXTURE_MAX_SIZE;
 	const int maxNewHeight = DEMO_TEXTURE_MAX_SIZE;
 
-	namespace fs = std::filesystem;
-
-	if (!fs::exists(DEMO_TEXTURE_CACHE_FOLDER))
-	{
-		fs::create_directories(DEMO_TEXTURE_CACHE_FOLDER);
-	}
-
-	const std::string srcFile = replaceAll(basePath + file, "\\", "/");
-	const std::string newFile = std::string(DEMO_TEXTURE_CACHE_FOLDER) +
-								lowercaseString(replaceAll(replaceAll(srcFile, "..", "__"), "/", "__") + std::string("__rescaled")) +
-								std::string(".ktx");
-
 	// load this image
 	int origWidth, origHeight, texChannels;
 	stbi_uc *pixels = stbi_load(fixTextureFile(srcFile).c_str(), &origWidth, &origHeight, &texChannels, STBI_rgb_alpha);
@@ -93,9 +107,8 @@ std::string convertTexture(
 		printf("Loaded [%s] %dx%d texture with %d channels\n", srcFile.c_str(), origWidth, origHeight, texChannels);
 	}
 
-	if (opacityMapIndices.count(file) > 0)
+	if (!opacityMapFile.empty())
 	{
-		const std::string opacityMapFile = replaceAll(basePath + opacityMaps[opacityMapIndices[file]], "\\", "/");
 		int opacityWidth, opacityHeight;
 		stbi_uc *opacityPixels = stbi_load(fixTextureFile(opacityMapFile).c_str(), &opacityWidth, &opacityHeight, nullptr, 1);
 
@@ -190,13 +203,95 @@ std::string convertTexture(
 	ktxTexture_WriteToNamedFile(ktxTexture(textureKTX1), newFile.c_str());
 	ktxTexture_Destroy(ktxTexture(textureKTX1));
 	ktxTexture_Destroy(ktxTexture(textureKTX2));
+}
+
+// the sources of a cached texture: the image and, optionally, its opacity mask
+std::vector<std::string> getTextureSources(const std::string &srcFile, const std::string &opacityMapFile)
+{
+	// hash the files that are actually loaded, see fixTextureFile()
+	auto getSource = [](const std::string &file)
+	{
+		const std::string fixed = fixTextureFile(file);
+		return fixed.empty() ? file : fixed;
+	};
+
+	std::vector<std::string> sources = {getSource(srcFile)};
+
+	if (!opacityMapFile.empty())
+		sources.push_back(getSource(opacityMapFile));
+
+	return sources;
+}
+
+// Returns the name of the converted texture. With a cache, the texture is converted only if it is missing or stale
+std::string convertTexture(
+	const std::string &file, const std::string &basePath, std::unordered_map<std::string, uint32_t> &opacityMapIndices,
+	const std::vector<std::string> &opacityMaps, AssetCacheManifest *cache = nullptr)
+{
+	namespace fs = std::filesystem;
+
+	if (!fs::exists(DEMO_TEXTURE_CACHE_FOLDER))
+	{
+		fs::create_directories(DEMO_TEXTURE_CACHE_FOLDER);
+	}
+
+	const std::string srcFile = replaceAll(basePath + file, "\\", "/");
+	const std::string newFile = std::string(DEMO_TEXTURE_CACHE_FOLDER) +
+								lowercaseString(replaceAll(replaceAll(srcFile, "..", "__"), "/", "__") + std::string("__rescaled")) +
+								std::string(".ktx");
+	const std::string opacityMapFile =
+		opacityMapIndices.count(file) > 0 ? replaceAll(basePath + opacityMaps[opacityMapIndices[file]], "\\", "/") : std::string();
+
+	const std::vector<std::string> sources = getTextureSources(srcFile, opacityMapFile);
+
+	if (cache && isAssetUpToDate(*cache, newFile, getTextureCacheParams(), sources))
+		return newFile;
+
+	convertTextureFile(srcFile, opacityMapFile, newFile);
+
+	if (cache)
+		updateAsset(*cache, newFile, getTextureCacheParams(), sources);
 
 	return newFile;
 }
 
+// Reconvert the stale textures of the cache folder from the sources recorded in the manifest, e.g. when a texture was edited
+// but the .obj files referencing it are unchanged and are not reconverted. Returns the number of stale textures, with dryRun
+// they are only listed
+uint32_t refreshCachedTextures(AssetCacheManifest &cache, bool dryRun = false)
+{
+	const uint64_t params = getTextureCacheParams();
+
+	std::vector<std::string> stale;
+
+	for (const std::string &tex : getCachedAssets(cache, DEMO_TEXTURE_CACHE_FOLDER))
+		if (!isAssetUpToDate(cache, tex, params))
+			stale.push_back(tex);
+
+	if (dryRun)
+	{
+		for (const std::string &tex : stale)
+			printf("Stale texture: %s\n", tex.c_str());
+
+		return (uint32_t)stale.size();
+	}
+
+	parallelFor(
+		(uint32_t)stale.size(), [&cache, &stale, params](uint32_t i)
+		{
+			const std::string &tex = stale[i];
+			const std::vector<std::string> sources = getAssetSources(cache, tex);
+			if (sources.empty())
+				return;
+			convertTextureFile(sources[0], sources.size() > 1 ? sources[1] : std::string(), tex);
+			updateAsset(cache, tex, params, sources); });
+
+	return (uint32_t)stale.size();
+}
+
 void convertAndDownscaleAllTextures(
 	const std::vector<Material> &materials, const std::string &basePath, std::vector<std::string> &files,
-	std::vector<std::string> &opacityMaps)
+	std::vector<std::string> &opacityMaps, AssetCacheManifest *cache = nullptr)
 {
 	std::unordered_map<std::string, uint32_t> opacityMapIndices(files.size());
 
@@ -204,12 +299,27 @@ void convertAndDownscaleAllTextures(
 		if (m.opacityTexture != -1 && m.baseColorTexture != -1)
 			opacityMapIndices[files[m.baseColorTexture]] = (uint32_t)m.opacityTexture;
 
-	auto converter = [&](const std::string &s) -> std::string
-	{
-		return convertTexture(s, basePath, opacityMapIndices, opacityMaps);
-	};
+	parallelFor((uint32_t)files.size(), [&](uint32_t i) { files[i] = convertTexture(files[i], basePath, opacityMapIndices, opacityMaps, cache); });
+}
 
-	std::transform(std::execution::par, std::begin(files), std::end(files), std::begin(files), converter);
+void printPrefix(int ofs)
+{
+	for (int i = 0; i < ofs; i++)
+		printf("\t");
+}
+
+void printMat4(const aiMatrix4x4 &m)
+{
+	if (!m.IsIdentity())
+	{
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				printf("%f ;", m[i][j]);
+	}
+	else
+	{
+		printf(" Identity");
+	}
 }
 
 void traverse(const aiScene *sourceScene, Scene &scene, aiNode *N, int parent, int depth)
@@ -228,16 +338,13 @@ void traverse(const aiScene *sourceScene, Scene &scene, aiNode *N, int parent, i
 
 	for (size_t i = 0; i < N->mNumMeshes; i++)
 	{
-		const int newSubNode = addNode(scene, newNode, depth + 1);
+		const int mesh = (int)N->mMeshes[i];
+		const int newSubNode = addNode(scene, newNode, depth + 1, mesh, (int)sourceScene->mMeshes[mesh]->mMaterialIndex);
 
 		const uint32_t stringID = (uint32_t)scene.nodeNames.size();
 		scene.nodeNames.push_back(std::string(N->mName.C_Str()) + "_Mesh_" + std::to_string(i));
 		scene.nameForNode[newSubNode] = stringID;
 
-		const int mesh = (int)N->mMeshes[i];
-		scene.meshForNode[newSubNode] = mesh;
-		scene.materialForNode[newSubNode] = sourceScene->mMeshes[mesh]->mMaterialIndex;
-
 		printPrefix(depth);
 		printf("Node[%d].SubNode[%d].mesh     = %d\n", newNode, newSubNode, (int)mesh);
 		printPrefix(depth);
@@ -264,7 +371,8 @@ void traverse(const aiScene *sourceScene, Scene &scene, aiNode *N, int parent, i
 		traverse(sourceScene, scene, N->mChildren[n], newNode, depth + 1);
 }
 
-void loadMeshFile(const char *fileName, MeshData &meshData, Scene &ourScene, bool generateLODs)
+// with a cache, only the missing or stale textures are converted
+void loadMeshFile(const char *fileName, MeshData &meshData, Scene &ourScene, bool generateLODs, AssetCacheManifest *cache = nullptr)
 {
 	printf("Loading '%s'...\n", fileName);
 
@@ -284,34 +392,73 @@ void loadMeshFile(const char *fileName, MeshData &meshData, Scene &ourScene, boo
 	meshData.meshes.reserve(scene->mNumMeshes);
 	meshData.boxes.reserve(scene->mNumMeshes);
 
+	// 1. convert all meshes in parallel into their own buffers
+	std::vector<ConvertedMesh> converted(scene->mNumMeshes);
+	std::atomic<uint32_t> numConverted = 0;
+
+	parallelFor(
+		scene->mNumMeshes, [&](uint32_t i)
+		{
+			convertAIMeshGeometry(scene->mMeshes[i], generateLODs, converted[i]);
+			printf("\rConverting meshes %u/%u...", ++numConverted, scene->mNumMeshes);
+			fflush(stdout); });
+	printf("\n");
+
+	// 2. a prefix sum over the mesh sizes in the original order gives the same offsets as converting the meshes one by one
+	LVK_ASSERT(meshData.indexData.empty() && meshData.indexData16.empty() && meshData.vertexData.empty());
+
 	uint32_t indexOffset = 0;
+	uint32_t indexOffset16 = 0;
 	uint32_t vertexOffset = 0;
 
-	for (unsigned int i = 0; i != scene->mNumMeshes; i++)
+	// LOD statistics for the whole file, thousands of meshes are too many to print one by one
+	uint64_t numLODIndices[kMaxLODs] = {};
+	uint32_t numLODMeshes[kMaxLODs] = {};
+
+	for (const ConvertedMesh &cm : converted)
 	{
-		printf("\rConverting meshes %u/%u...", i + 1, scene->mNumMeshes);
-		fflush(stdout);
-		meshData.meshes.push_back(convertAIMesh(scene->mMeshes[i], meshData, indexOffset, vertexOffset, generateLODs));
+		meshData.meshes.push_back(getConvertedMeshDescriptor(cm, indexOffset, indexOffset16, vertexOffset));
+
+		for (size_t l = 0; l != cm.lods.size(); l++)
+		{
+			numLODIndices[l] += cm.lods[l].size();
+			numLODMeshes[l]++;
+		}
 	}
-	printf("\n");
+
+	for (uint32_t l = 0; l != kMaxLODs && numLODMeshes[l]; l++)
+		printf("   LOD%u: %u meshes, %llu indices\n", l, numLODMeshes[l], (unsigned long long)numLODIndices[l]);
+
+	// 3. concatenate, every mesh writes to its own range
+	meshData.streams = getAIMeshVertexStreams();
+	meshData.indexData.resize(indexOffset);
+	meshData.indexData16.resize(indexOffset16);
+	meshData.vertexData.resize((size_t)vertexOffset * meshData.streams.getVertexSize());
+
+	parallelFor(scene->mNumMeshes, [&](uint32_t i) { copyConvertedMesh(converted[i], meshData.meshes[i], meshData); });
+
+	converted.clear();
 
 	// extract base model path
 	const std::size_t pathSeparator = std::string(fileName).find_last_of("/\\");
 	const std::string basePath = (pathSeparator != std::string::npos) ? std::string(fileName).substr(0, pathSeparator + 1) : std::string();
 
-	std::vector<std::string> opacityMaps;
+	StringTable textureFiles;
+	StringTable opacityMaps;
 
 	for (unsigned int i = 0; i != scene->mNumMaterials; i++)
 	{
 		printf("\rConverting materials %u/%u...", i + 1, scene->mNumMaterials);
 		const aiMaterial *m = scene->mMaterials[i];
 		ourScene.materialNames.push_back(m->GetName().C_Str());
-		meshData.materials.push_back(convertAIMaterial(m, meshData.textureFiles, opacityMaps));
+		meshData.materials.push_back(convertAIMaterial(m, textureFiles, opacityMaps));
 	}
 	printf("\n");
 
+	meshData.textureFiles = std::move(textureFiles.strings);
+
 	// texture processing, rescaling and packing
-	convertAndDownscaleAllTextures(meshData.materials, basePath, meshData.textureFiles, opacityMaps);
+	convertAndDownscaleAllTextures(meshData.materials, basePath, meshData.textureFiles, opacityMaps.strings, cache);
 
 	recalculateBoundingBoxes(meshData);
 
@@ -4,19 +4,13 @@
 
 #include "shared/UtilsGLTF.h"
 
-struct DrawIndexedIndirectCommand
-{
-	uint32_t count;
-	uint32_t instanceCount;
-	uint32_t firstIndex;
-	int32_t baseVertex;
-	uint32_t baseInstance;
-};
-
 struct DrawData
 {
 	uint32_t transformId;
 	uint32_t materialId;
+	// dequantization of the mesh's vertex positions, see Mesh::posOffset and Mesh::posScale
+	float posOffset[3] = {0.0f, 0.0f, 0.0f};
+	float posScale[3] = {1.0f, 1.0f, 1.0f};
 };
 
 // textureId -> TextureHandle
@@ -59,7 +53,7 @@ GLTFMaterialDataGPU convertToGPUMaterial(
 }
 
 // NOTE: this function was manually tweaked to load Bistro materials from .obj - use UtilsGLTF.h for anything else
-Material convertAIMaterial(const aiMaterial *M, std::vector<std::string> &files, std::vector<std::string> &opacityMaps)
+Material convertAIMaterial(const aiMaterial *M, StringTable &files, StringTable &opacityMaps)
 {
 	Material D;
 
@@ -121,13 +115,13 @@ Material convertAIMaterial(const aiMaterial *M, std::vector<std::string> &files,
 	if (aiGetMaterialTexture(M, aiTextureType_EMISSIVE, 0, &path, &mapping, &uvIndex, &blend, &textureOp, textureMapMode, &textureFlags) ==
 		AI_SUCCESS)
 	{
-		D.emissiveTexture = addUnique(files, path.C_Str());
+		D.emissiveTexture = internPath(files, path.C_Str());
 	}
 
 	if (aiGetMaterialTexture(M, aiTextureType_DIFFUSE, 0, &path, &mapping, &uvIndex, &blend, &textureOp, textureMapMode, &textureFlags) ==
 		AI_SUCCESS)
 	{
-		D.baseColorTexture = addUnique(files, path.C_Str());
+		D.baseColorTexture = internPath(files, path.C_Str());
 		const std::string albedoMap = std::string(path.C_Str());
 		if (albedoMap.find("grey_30") != albedoMap.npos)
 			D.flags |= sMaterialFlags_Transparent;
@@ -137,18 +131,18 @@ Material convertAIMaterial(const aiMaterial *M, std::vector<std::string> &files,
 	if (aiGetMaterialTexture(M, aiTextureType_NORMALS, 0, &path, &mapping, &uvIndex, &blend, &textureOp, textureMapMode, &textureFlags) ==
 		AI_SUCCESS)
 	{
-		D.normalTexture = addUnique(files, path.C_Str());
+		D.normalTexture = internPath(files, path.C_Str());
 	}
 	// then height map
 	if (D.normalTexture == -1)
 		if (aiGetMaterialTexture(M, aiTextureType_HEIGHT, 0, &path, &mapping, &uvIndex, &blend, &textureOp, textureMapMode, &textureFlags) ==
 			AI_SUCCESS)
-			D.normalTexture = addUnique(files, path.C_Str());
+			D.normalTexture = internPath(files, path.C_Str());
 
 	if (aiGetMaterialTexture(M, aiTextureType_OPACITY, 0, &path, &mapping, &uvIndex, &blend, &textureOp, textureMapMode, &textureFlags) ==
 		AI_SUCCESS)
 	{
-		D.opacityTexture = addUnique(opacityMaps, path.C_Str());
+		D.opacityTexture = internPath(opacityMaps, path.C_Str());
 		D.alphaTest = 0.5f;
 	}
 
@@ -225,64 +219,28 @@ Material convertAIMaterial(const aiMaterial *M, std::vector<std::string> &files,
 	return D;
 }
 
-void processLODs(
-	std::vector<uint32_t> &indices, std::vector<uint8_t> &vertices, size_t vertexStride, std::vector<std::vector<uint32_t>> &outLods,
-	bool generateLods)
+// pos, uv, normal
+inline lvk::VertexInput getAIMeshVertexStreams()
 {
-	size_t verticesCountIn = vertices.size() / vertexStride;
-	size_t targetIndicesCount = indices.size();
-
-	printf("\n   LOD0: %i indices", int(indices.size()));
-
-	outLods.push_back(indices);
-
-	if (!generateLods)
-		return;
-
-	uint8_t LOD = 1;
-
-	while (targetIndicesCount > 1024 && LOD < kMaxLODs)
-	{
-		targetIndicesCount /= 2;
-
-		bool sloppy = false;
-
-		size_t numOptIndices = meshopt_simplify(
-			indices.data(), indices.data(), (uint32_t)indices.size(), (const float *)vertices.data(), verticesCountIn, vertexStride,
-			targetIndicesCount, 0.02f, 0, nullptr);
-
-		// cannot simplify further
-		if (static_cast<size_t>(numOptIndices * 1.1f) > indices.size())
-		{
-			if (LOD > 1)
-			{
-				// try harder
-				numOptIndices = meshopt_simplifySloppy(
-					indices.data(), indices.data(), indices.size(), (const float *)vertices.data(), verticesCountIn, vertexStride,
-					targetIndicesCount, 0.02f, nullptr);
-				sloppy = true;
-				if (numOptIndices == indices.size())
-					break;
-			}
-			else
-				break;
-		}
-
-		indices.resize(numOptIndices);
-
-		meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), verticesCountIn);
-
-		printf("\n   LOD%i: %i indices %s", int(LOD), int(numOptIndices), sloppy ? "[sloppy]" : "");
-
-		LOD++;
-
-		outLods.push_back(indices);
-	}
-
-	printf("\n");
+	return {
+		.attributes = {{.location = 0, .format = lvk::VertexFormat::Float3, .offset = 0},											 // pos
+					   {.location = 1, .format = lvk::VertexFormat::HalfFloat2, .offset = sizeof(vec3)},							 // uv
+					   {.location = 2, .format = lvk::VertexFormat::Int_2_10_10_10_REV, .offset = sizeof(vec3) + sizeof(uint32_t)}}, // n
+		.inputBindings = {{.stride = sizeof(vec3) + sizeof(uint32_t) + sizeof(uint32_t)}},
+	};
 }
 
-Mesh convertAIMesh(const aiMesh *m, MeshData &meshData, uint32_t &indexOffset, uint32_t &vertexOffset, bool generateLODs)
+// geometry of a single aiMesh with mesh-local indices, before it is placed into MeshData
+struct ConvertedMesh
+{
+	std::vector<uint8_t> vertices;
+	std::vector<std::vector<uint32_t>> lods;
+	std::vector<float> lodErrors;
+	uint32_t materialID = 0;
+};
+
+// The expensive part of the conversion (meshoptimizer passes and LODs). Touches nothing but `out`, so meshes can be converted in parallel
+void convertAIMeshGeometry(const aiMesh *m, bool generateLODs, ConvertedMesh &out)
 {
 	static_assert(sizeof(aiVector3D) == 3 * sizeof(float));
 
@@ -302,14 +260,6 @@ Mesh convertAIMesh(const aiMesh *m, MeshData &meshData, uint32_t &indexOffset, u
 		put(vertices, glm::packSnorm3x10_1x2(vec4(n.x, n.y, n.z, 0))); // normal: 2_10_10_10_REV
 	}
 
-	// pos, uv, normal
-	meshData.streams = {
-		.attributes = {{.location = 0, .format = lvk::VertexFormat::Float3, .offset = 0},											 // pos
-					   {.location = 1, .format = lvk::VertexFormat::HalfFloat2, .offset = sizeof(vec3)},							 // uv
-					   {.location = 2, .format = lvk::VertexFormat::Int_2_10_10_10_REV, .offset = sizeof(vec3) + sizeof(uint32_t)}}, // n
-		.inputBindings = {{.stride = sizeof(vec3) + sizeof(uint32_t) + sizeof(uint32_t)}},
-	};
-
 	for (unsigned int i = 0; i != m->mNumFaces; i++)
 	{
 		if (m->mFaces[i].mNumIndices != 3)
@@ -318,252 +268,83 @@ Mesh convertAIMesh(const aiMesh *m, MeshData &meshData, uint32_t &indexOffset, u
 			srcIndices.push_back(m->mFaces[i].mIndices[j]);
 	}
 
-	const uint32_t vertexStride = meshData.streams.getVertexSize();
+	const uint32_t vertexStride = getAIMeshVertexStreams().getVertexSize();
 
-	// optimize the entire mesh
-	{
-		const uint32_t vertexCountIn = vertices.size() / vertexStride;
-		std::vector<uint32_t> remap(vertexCountIn);
-		const size_t vertexCountOut =
-			meshopt_generateVertexRemap(remap.data(), srcIndices.data(), srcIndices.size(), vertices.data(), vertexCountIn, vertexStride);
-
-		std::vector<uint32_t> remappedIndices(srcIndices.size());
-		std::vector<uint8_t> remappedVertices(vertexCountOut * vertexStride);
-
-		meshopt_remapIndexBuffer(remappedIndices.data(), srcIndices.data(), srcIndices.size(), remap.data());
-		meshopt_remapVertexBuffer(remappedVertices.data(), vertices.data(), vertexCountIn, vertexStride, remap.data());
-
-		meshopt_optimizeVertexCache(remappedIndices.data(), remappedIndices.data(), srcIndices.size(), vertexCountOut);
-		meshopt_optimizeOverdraw(
-			remappedIndices.data(), remappedIndices.data(), srcIndices.size(), (const float *)remappedVertices.data(), vertexCountOut,
-			vertexStride, 1.05f);
-		meshopt_optimizeVertexFetch(
-			remappedVertices.data(), remappedIndices.data(), srcIndices.size(), remappedVertices.data(), vertexCountOut, vertexStride);
-
-		srcIndices = remappedIndices;
-		vertices = remappedVertices;
-		LVK_ASSERT(vertexCountOut == vertices.size() / vertexStride);
-	}
+	optimizeMeshGeometry(srcIndices, vertices, vertexStride);
+
+	out.lods.clear();
+	out.lodErrors.clear();
+	processLODs(srcIndices, vertices, vertexStride, out.lods, out.lodErrors, generateLODs);
+
+	out.vertices = std::move(vertices);
+	out.materialID = m->mMaterialIndex;
+}
 
-	const uint32_t numVertices = static_cast<uint32_t>(vertices.size() / vertexStride);
+// Place a converted mesh after the previous ones: indexOffset, indexOffset16 and vertexOffset are running offsets into
+// MeshData::indexData, MeshData::indexData16 and MeshData::vertexData (in vertices). No data is copied, see copyConvertedMesh()
+Mesh getConvertedMeshDescriptor(const ConvertedMesh &cm, uint32_t &indexOffset, uint32_t &indexOffset16, uint32_t &vertexOffset)
+{
+	const uint32_t numVertices = static_cast<uint32_t>(cm.vertices.size() / getAIMeshVertexStreams().getVertexSize());
 
-	std::vector<std::vector<uint32_t>> outLods;
-	processLODs(srcIndices, vertices, vertexStride, outLods, generateLODs);
+	// indices are local to the mesh, so 16 bits are enough for most meshes
+	const bool isIndex16 = numVertices <= 65536;
 
 	Mesh result = {
-		.indexOffset = indexOffset,
+		.indexOffset = isIndex16 ? indexOffset16 : indexOffset,
 		.vertexOffset = vertexOffset,
 		.vertexCount = numVertices,
+		.flags = isIndex16 ? (uint32_t)sMeshFlags_Index16 : 0u,
 	};
 
 	uint32_t numIndices = 0;
-	for (size_t l = 0; l < outLods.size(); l++)
+	for (size_t l = 0; l < cm.lods.size(); l++)
 	{
-		mergeVectors(meshData.indexData, outLods[l]);
 		result.lodOffset[l] = numIndices;
-		numIndices += (uint32_t)outLods[l].size();
+		result.lodError[l] = cm.lodErrors[l];
+		numIndices += (uint32_t)cm.lods[l].size();
 	}
 
-	mergeVectors(meshData.vertexData, vertices);
-
-	result.lodOffset[outLods.size()] = numIndices;
-	result.lodCount = (uint32_t)outLods.size();
-	result.materialID = m->mMaterialIndex;
+	result.lodOffset[cm.lods.size()] = numIndices;
+	result.lodCount = (uint32_t)cm.lods.size();
+	result.materialID = cm.materialID;
 
-	indexOffset += numIndices;
+	(isIndex16 ? indexOffset16 : indexOffset) += numIndices;
 	vertexOffset += numVertices;
 
 	return result;
 }
 
-class VKMesh final
+// copy the indices and vertices to the location described by `mesh`; the arrays of meshData must be large enough
+void copyConvertedMesh(const ConvertedMesh &cm, const Mesh &mesh, MeshData &meshData)
 {
-public:
-	VKMesh(
-		const std::unique_ptr<lvk::IContext> &ctx, const MeshData &meshData, const Scene &scene, lvk::Format colorFormat,
-		lvk::Format depthFormat, uint32_t numSamples = 1)
-		: ctx(ctx), numIndices_((uint32_t)meshData.indexData.size()), numMeshes_((uint32_t)meshData.meshes.size()), textureFiles_(meshData.textureFiles)
-	{
-		const MeshFileHeader header = meshData.getMeshFileHeader();
-
-		const uint32_t *indices = meshData.indexData.data();
-		const uint8_t *vertexData = meshData.vertexData.data();
-
-		std::vector<GLTFMaterialDataGPU> materials;
-
-		materials.reserve(meshData.materials.size());
-
-		for (const auto &mat : meshData.materials)
-		{
-			materials.push_back(convertToGPUMaterial(ctx, mat, textureFiles_, textureCache_));
-		}
-
-		bufferVertices_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Vertex,
-			 .storage = lvk::StorageType_Device,
-			 .size = header.vertexDataSize,
-			 .data = vertexData,
-			 .debugName = "Buffer: vertex"},
-			nullptr);
-		bufferIndices_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Index,
-			 .storage = lvk::StorageType_Device,
-			 .size = header.indexDataSize,
-			 .data = indices,
-			 .debugName = "Buffer: index"},
-			nullptr);
-		bufferTransforms_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Storage,
-			 .storage = lvk::StorageType_Device,
-			 .size = scene.globalTransform.size() * sizeof(glm::mat4),
-			 .data = scene.globalTransform.data(),
-			 .debugName = "Buffer: transforms"},
-			nullptr);
-		bufferMaterials_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Storage,
-			 .storage = lvk::StorageType_Device,
-			 .size = materials.size() * sizeof(decltype(materials)::value_type),
-			 .data = materials.data(),
-			 .debugName = "Buffer: materials"},
-			nullptr);
-
-		std::vector<DrawIndexedIndirectCommand> drawCommands;
-		std::vector<DrawData> drawData;
-
-		const uint32_t numCommands = header.meshCount;
-
-		drawCommands.resize(numCommands);
-		drawData.resize(numCommands);
-
-		DrawIndexedIndirectCommand *cmd = drawCommands.data();
-		DrawData *dd = drawData.data();
-
-		LVK_ASSERT(scene.meshForNode.size() == numCommands);
-
-		uint32_t ddIndex = 0;
-
-		// prepare indirect commands buffer
-		for (auto &i : scene.meshForNode)
-		{
-			const Mesh &mesh = meshData.meshes[i.second];
-
-			const uint32_t lod = std::min(0u, mesh.lodCount - 1); // TODO: implement dynamic lod
-
-			*cmd++ = {
-				.count = mesh.getLODIndicesCount(lod),
-				.instanceCount = 1,
-				.firstIndex = mesh.indexOffset, // + mesh.lodOffset[lod],
-				.baseVertex = (int32_t)mesh.vertexOffset,
-				.baseInstance = ddIndex++,
-			};
-			*dd++ = {
-				.transformId = i.first,
-				.materialId = mesh.materialID,
-			};
-		}
-
-		bufferIndirect_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Indirect,
-			 .storage = lvk::StorageType_Device,
-			 .size = sizeof(DrawIndexedIndirectCommand) * numCommands,
-			 .data = drawCommands.data(),
-			 .debugName = "Buffer: indirect"},
-			nullptr);
-
-		bufferDrawData_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Storage,
-			 .storage = lvk::StorageType_Device,
-			 .size = sizeof(DrawData) * numCommands,
-			 .data = drawData.data(),
-			 .debugName = "Buffer: drawData"},
-			nullptr);
-
-		vert_ = loadShaderModule(ctx, "../../src/shaders/scenegraph/main.vert");
-		frag_ = loadShaderModule(ctx, "../../src/shaders/scenegraph/main.frag");
-
-		pipeline_ = ctx->createRenderPipeline({
-			.vertexInput = meshData.streams,
-			.smVert = vert_,
-			.smFrag = frag_,
-			.color = {{.format = colorFormat}},
-			.depthFormat = depthFormat,
-			.cullMode = lvk::CullMode_None,
-			.samplesCount = numSamples,
-			.minSampleShading = numSamples > 1 ? 0.25f : 0.0f,
-		});
-
-		pipelineWireframe_ = ctx->createRenderPipeline({
-			.vertexInput = meshData.streams,
-			.smVert = vert_,
-			.smFrag = frag_,
-			.color = {{.format = colorFormat}},
-			.depthFormat = depthFormat,
-			.cullMode = lvk::CullMode_None,
-			.polygonMode = lvk::PolygonMode_Line,
-			.samplesCount = numSamples,
-		});
-
-		LVK_ASSERT(pipeline_.valid());
-	}
-
-	void draw(
-		lvk::ICommandBuffer &buf, const mat4 &view, const mat4 &proj, lvk::TextureHandle texSkyboxIrradiance = {},
-		bool wireframe = false) const
-	{
-		buf.cmdBindIndexBuffer(bufferIndices_, lvk::IndexFormat_UI32);
-		buf.cmdBindVertexBuffer(0, bufferVertices_);
-		buf.cmdBindRenderPipeline(wireframe ? pipelineWireframe_ : pipeline_);
-		buf.cmdBindDepthState({.compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true});
-		const struct
-		{
-			mat4 viewProj;
-			uint64_t bufferTransforms;
-			uint64_t bufferDrawData;
-			uint64_t bufferMaterials;
-			uint32_t texSkyboxIrradiance;
-		} pc = {
-			.viewProj = proj * view,
-			.bufferTransforms = ctx->gpuAddress(bufferTransforms_),
-			.bufferDrawData = ctx->gpuAddress(bufferDrawData_),
-			.bufferMaterials = ctx->gpuAddress(bufferMaterials_),
-			.texSkyboxIrradiance = texSkyboxIrradiance.index(),
-		};
-		static_assert(sizeof(pc) <= 128);
-		buf.cmdPushConstants(pc);
-		buf.cmdDrawIndexedIndirect(bufferIndirect_, 0, numMeshes_);
-	}
-	void updateGlobalTransforms(const mat4 *data, size_t numMatrices) const
+	for (size_t l = 0; l < cm.lods.size(); l++)
 	{
-		ctx->upload(bufferTransforms_, data, numMatrices * sizeof(mat4));
+		const uint32_t offset = mesh.indexOffset + mesh.lodOffset[l];
+		if (mesh.isIndex16())
+			std::copy(cm.lods[l].begin(), cm.lods[l].end(), meshData.indexData16.begin() + offset);
+		else
+			std::copy(cm.lods[l].begin(), cm.lods[l].end(), meshData.indexData.begin() + offset);
 	}
 
-	void updateMaterial(const Material *materials, int updateMaterialIndex) const
-	{
-		if (updateMaterialIndex < 0)
-			return;
-		const GLTFMaterialDataGPU mat = convertToGPUMaterial(ctx, materials[updateMaterialIndex], textureFiles_, textureCache_);
-		ctx->upload(bufferMaterials_, &mat, sizeof(mat), sizeof(mat) * updateMaterialIndex);
-	}
+	std::copy(cm.vertices.begin(), cm.vertices.end(), meshData.vertexData.begin() + (size_t)mesh.vertexOffset * meshData.streams.getVertexSize());
+}
 
-public:
-	const std::unique_ptr<lvk::IContext> &ctx;
+// indexOffset and indexOffset16 are running offsets into MeshData::indexData and MeshData::indexData16
+Mesh convertAIMesh(
+	const aiMesh *m, MeshData &meshData, uint32_t &indexOffset, uint32_t &indexOffset16, uint32_t &vertexOffset, bool generateLODs)
+{
+	ConvertedMesh cm;
+	convertAIMeshGeometry(m, generateLODs, cm);
 
-	uint32_t numIndices_ = 0;
-	uint32_t numMeshes_ = 0;
+	meshData.streams = getAIMeshVertexStreams();
 
-	lvk::Holder<lvk::BufferHandle> bufferIndices_;
-	lvk::Holder<lvk::BufferHandle> bufferVertices_;
-	lvk::Holder<lvk::BufferHandle> bufferIndirect_;
-	lvk::Holder<lvk::BufferHandle> bufferTransforms_;
-	lvk::Holder<lvk::BufferHandle> bufferDrawData_;
-	lvk::Holder<lvk::BufferHandle> bufferMaterials_;
+	const Mesh result = getConvertedMeshDescriptor(cm, indexOffset, indexOffset16, vertexOffset);
 
-	lvk::Holder<lvk::ShaderModuleHandle> vert_;
-	lvk::Holder<lvk::ShaderModuleHandle> frag_;
+	meshData.indexData.resize(indexOffset);
+	meshData.indexData16.resize(indexOffset16);
+	meshData.vertexData.resize((size_t)vertexOffset * meshData.streams.getVertexSize());
 
-	lvk::Holder<lvk::RenderPipelineHandle> pipeline_;
-	lvk::Holder<lvk::RenderPipelineHandle> pipelineWireframe_;
+	copyConvertedMesh(cm, result, meshData);
 
-	TextureFiles textureFiles_;
-	mutable TextureCache textureCache_;
-};
\ No newline at end of file
+	return result;
+}
@@ -2,6 +2,14 @@
 
 #include "VKMesh08.h"
 
+#include <lvk/vulkan/VulkanClasses.h>
+
+#include <taskflow/taskflow.hpp>
+#include <taskflow/algorithm/for_each.hpp>
+
+#include <limits>
+#include <numeric>
+
 class VKIndirectBuffer11 final
 {
 public:
@@ -26,13 +34,30 @@ public:
 		ctx_->upload(bufferIndirect_, drawCommands_.data(), sizeof(VkDrawIndexedIndirectCommand) * numCommands, sizeof(uint32_t));
 	};
 
+	// same as above, but the instance counts are replaced, e.g. to mask out the draws whose geometry is not resident. drawCommands_ is
+	// not modified
+	void uploadIndirectBuffer(const std::function<uint32_t(const DrawIndexedIndirectCommand &)> &getInstanceCount)
+	{
+		std::vector<DrawIndexedIndirectCommand> commands = drawCommands_;
+		for (DrawIndexedIndirectCommand &c : commands)
+			c.instanceCount = getInstanceCount(c);
+		const uint32_t numCommands = commands.size();
+		ctx_->upload(bufferIndirect_, &numCommands, sizeof(uint32_t));
+		ctx_->upload(bufferIndirect_, commands.data(), sizeof(VkDrawIndexedIndirectCommand) * numCommands, sizeof(uint32_t));
+	}
+
 	void selectTo(VKIndirectBuffer11 &buf, const std::function<bool(const DrawIndexedIndirectCommand &)> &pred) const
 	{
 		buf.drawCommands_.clear();
-		for (const auto &c : drawCommands_)
+		buf.numCommands32_ = 0;
+		for (size_t i = 0; i != drawCommands_.size(); i++)
 		{
-			if (pred(c))
-				buf.drawCommands_.push_back(c);
+			if (!pred(drawCommands_[i]))
+				continue;
+			buf.drawCommands_.push_back(drawCommands_[i]);
+			// the order is preserved, so the 32-bit commands stay in front
+			if (i < numCommands32_)
+				buf.numCommands32_++;
 		}
 		buf.uploadIndirectBuffer();
 	}
@@ -49,6 +74,9 @@ public:
 	lvk::Holder<lvk::BufferHandle> bufferIndirect_;
 
 	std::vector<DrawIndexedIndirectCommand> drawCommands_;
+
+	// commands drawing meshes with 32-bit indices go first, followed by the commands for 16-bit meshes
+	uint32_t numCommands32_ = 0;
 };
 
 class VKPipeline11 final
@@ -57,6 +85,7 @@ public:
 	VKPipeline11(
 		const std::unique_ptr<lvk::IContext> &ctx, const lvk::VertexInput &streams, lvk::Format colorFormat, lvk::Format depthFormat,
 		uint32_t numSamples = 1, lvk ::Holder<lvk::ShaderModuleHandle> &&vert = {}, lvk::Holder<lvk::ShaderModuleHandle> &&frag = {})
+		: positionOnly_(isPositionStream(streams))
 	{
 		vert_ = vert.valid() ? std::move(vert) : loadShaderModule(ctx, "../../src/shaders/scenegraph/main.vert");
 		frag_ = frag.valid() ? std::move(frag) : loadShaderModule(ctx, "../../src/shaders/scenegraph/main.frag");
@@ -88,6 +117,9 @@ public:
 	}
 
 public:
+	// created with getPositionStream(), VKMesh11 binds its position-only vertex and shadow index buffers
+	bool positionOnly_ = false;
+
 	lvk::Holder<lvk::ShaderModuleHandle> vert_;
 	lvk::Holder<lvk::ShaderModuleHandle> frag_;
 
@@ -101,35 +133,103 @@ public:
 	VKMesh11(
 		const std::unique_ptr<lvk::IContext> &ctx, const MeshData &meshData, const Scene &scene,
 		lvk::StorageType indirectBufferStorage = lvk::StorageType_Device, bool preloadMaterials = true)
-		: ctx(ctx), numIndices_((uint32_t)meshData.indexData.size()), numMeshes_((uint32_t)meshData.meshes.size()), indirectBuffer_(ctx, meshData.getMeshFileHeader().meshCount, indirectBufferStorage), textureFiles_(meshData.textureFiles)
+		: VKMesh11(ctx, MeshDataView(meshData), meshData.materials, meshData.textureFiles, scene, indirectBufferStorage, preloadMaterials)
 	{
-		const MeshFileHeader header = meshData.getMeshFileHeader();
+	}
 
+	// Geometry is uploaded straight from the view (e.g. a memory-mapped .meshes file) without intermediate CPU copies.
+	// With streamGeometry the vertex and index buffers are only allocated here and filled batch by batch by streamGeometry(),
+	// the view has to outlive this object then. Compressed views and views without depth-only geometry (see
+	// MeshDataView::hasDepthGeometry()) are always uploaded by streamGeometry(), every mesh is decoded or gets its depth-only geometry
+	// built right before it is staged
+	VKMesh11(
+		const std::unique_ptr<lvk::IContext> &ctx, const MeshDataView &meshData, const std::vector<Material> &materials,
+		const TextureFiles &textureFiles, const Scene &scene, lvk::StorageType indirectBufferStorage = lvk::StorageType_Device,
+		bool preloadMaterials = true, bool streamGeometry = false)
+		: ctx(ctx), numIndices_((uint32_t)(meshData.getIndexDataSize() / sizeof(uint32_t) + meshData.getIndexData16Size() / sizeof(uint16_t))), numMeshes_((uint32_t)meshData.meshes.size()), indirectBuffer_(ctx, meshData.meshes.size(), indirectBufferStorage), textureFiles_(textureFiles)
+	{
 		const uint32_t *indices = meshData.indexData.data();
 		const uint8_t *vertexData = meshData.vertexData.data();
 
-		materialsCPU_ = meshData.materials;
-		materialsGPU_.reserve(meshData.materials.size());
-
-		for (const auto &mat : meshData.materials)
+		// Everything is uploaded here straight from the view, unless it has to be streamed, decoded or the depth-only geometry has to be
+		// built first. If a checksum of the mapped geometry does not match, the geometry is uploaded by streamGeometry() below instead
+		// and the meshes in the corrupted chunks are skipped
+		const bool uploadGeometry = !streamGeometry && !meshData.isCompressed() && meshData.hasDepthGeometry() &&
+									meshData.verifyChunks(meshData.indexData.data(), meshData.indexData.size_bytes()) &&
+									meshData.verifyChunks(meshData.indexData16.data(), meshData.indexData16.size_bytes()) &&
+									meshData.verifyChunks(meshData.vertexData.data(), meshData.vertexData.size_bytes()) &&
+									meshData.verifyChunks(meshData.positions.data(), meshData.positions.size_bytes()) &&
+									meshData.verifyChunks(meshData.shadowIndices.data(), meshData.shadowIndices.size_bytes()) &&
+									meshData.verifyChunks(meshData.shadowIndices16.data(), meshData.shadowIndices16.size_bytes());
+
+		materialsCPU_ = materials;
+		materialsGPU_.reserve(materials.size());
+
+		for (const auto &mat : materials)
 		{
 			materialsGPU_.push_back(preloadMaterials ? convertToGPUMaterial(ctx, mat, textureFiles_, textureCache_) : GLTFMaterialDataGPU{});
 		}
 
+		// VKMesh11Lazy converts the materials later
+		if (preloadMaterials)
+			releaseCPUMaterials();
+
+		// The geometry buffers are storage buffers too: streamGeometry() writes them from a compute shader (see submitStagingBatch()).
+		// Their sizes are rounded up to whole 32-bit words
 		bufferVertices_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Vertex,
+			{.usage = lvk::BufferUsageBits_Vertex | lvk::BufferUsageBits_Storage,
 			 .storage = lvk::StorageType_Device,
-			 .size = header.vertexDataSize,
-			 .data = vertexData,
+			 .size = getWordAlignedSize(meshData.getVertexDataSize()),
 			 .debugName = "Buffer: vertex"},
 			nullptr);
+		if (!meshData.vertexData.empty() && uploadGeometry)
+			ctx->upload(bufferVertices_, vertexData, meshData.vertexData.size_bytes());
+		// Index buffer layout: | 32-bit indices | 16-bit indices |. Both sections are bound separately
+		indexOffset16_ = meshData.getIndexDataSize();
 		bufferIndices_ = ctx->createBuffer(
-			{.usage = lvk::BufferUsageBits_Index,
+			{.usage = lvk::BufferUsageBits_Index | lvk::BufferUsageBits_Storage,
 			 .storage = lvk::StorageType_Device,
-			 .size = header.indexDataSize,
-			 .data = indices,
+			 .size = getWordAlignedSize(indexOffset16_ + meshData.getIndexData16Size()),
 			 .debugName = "Buffer: index"},
 			nullptr);
+		if (!meshData.indexData.empty() && uploadGeometry)
+			ctx->upload(bufferIndices_, indices, meshData.indexData.size_bytes());
+		if (!meshData.indexData16.empty() && uploadGeometry)
+			ctx->upload(bufferIndices_, meshData.indexData16.data(), meshData.indexData16.size_bytes(), indexOffset16_);
+
+		// Position-only stream for depth-only passes: 8 or 12 bytes per vertex instead of the full interleaved vertex, and shadow
+		// indices welding the vertices split by UV and normal seams. Same layout as the full streams, so the same draw commands work
+		positionSize_ = getPositionStream(meshData.streams).getVertexSize();
+		const size_t numVertices = meshData.getVertexDataSize() / meshData.streams.getVertexSize();
+		bufferPositions_ = ctx->createBuffer(
+			{.usage = lvk::BufferUsageBits_Vertex | lvk::BufferUsageBits_Storage,
+			 .storage = lvk::StorageType_Device,
+			 .size = getWordAlignedSize(numVertices * positionSize_),
+			 .debugName = "Buffer: positions"},
+			nullptr);
+		bufferShadowIndices_ = ctx->createBuffer(
+			{.usage = lvk::BufferUsageBits_Index | lvk::BufferUsageBits_Storage,
+			 .storage = lvk::StorageType_Device,
+			 .size = getWordAlignedSize(indexOffset16_ + meshData.getIndexData16Size()),
+			 .debugName = "Buffer: shadow indices"},
+			nullptr);
+		if (!meshData.positions.empty() && uploadGeometry)
+			ctx->upload(bufferPositions_, meshData.positions.data(), meshData.positions.size_bytes());
+		if (!meshData.shadowIndices.empty() && uploadGeometry)
+			ctx->upload(bufferShadowIndices_, meshData.shadowIndices.data(), meshData.shadowIndices.size_bytes());
+		if (!meshData.shadowIndices16.empty() && uploadGeometry)
+			ctx->upload(bufferShadowIndices_, meshData.shadowIndices16.data(), meshData.shadowIndices16.size_bytes(), indexOffset16_);
+
+		streamSource_ = uploadGeometry ? nullptr : &meshData;
+		if (streamSource_)
+		{
+			copyRegions_ = loadShaderModule(ctx, "../../src/shaders/scenegraph/CopyRegions.comp");
+			pipelineCopyRegions_ = ctx->createComputePipeline({.smComp = copyRegions_});
+			LVK_ASSERT(pipelineCopyRegions_.valid());
+			streamExecutor_ = std::make_unique<tf::Executor>(getNumConversionThreads());
+		}
+		meshResident_.assign(numMeshes_, uploadGeometry ? 1 : 0);
+		numResidentMeshes_ = uploadGeometry ? numMeshes_ : 0;
 		bufferTransforms_ = ctx->createBuffer(
 			{.usage = lvk::BufferUsageBits_Storage,
 			 .storage = lvk::StorageType_Device,
@@ -140,59 +240,90 @@ public:
 		bufferMaterials_ = ctx->createBuffer(
 			{.usage = lvk::BufferUsageBits_Storage,
 			 .storage = lvk::StorageType_Device,
-			 .size = meshData.materials.size() * sizeof(decltype(materialsGPU_)::value_type),
+			 .size = materials.size() * sizeof(decltype(materialsGPU_)::value_type),
 			 .data = materialsGPU_.data(),
 			 .debugName = "Buffer: materials"},
 			nullptr);
 
-		const uint32_t numCommands = header.meshCount;
+		// one DrawData entry per node, the instances of a mesh are consecutive and addressed via gl_InstanceIndex
+		const uint32_t numDrawData = (uint32_t)scene.meshForNode.size();
 
-		indirectBuffer_.drawCommands_.resize(numCommands);
-		drawData_.resize(numCommands);
+		indirectBuffer_.drawCommands_.clear();
+		indirectBuffer_.drawCommands_.reserve(numMeshes_);
+		drawData_.resize(numDrawData);
+		drawDataMesh_.resize(numDrawData);
 
-		DrawIndexedIndirectCommand *cmd = indirectBuffer_.drawCommands_.data();
 		DrawData *dd = drawData_.data();
 
-		LVK_ASSERT(scene.meshForNode.size() == numCommands);
-
 		uint32_t ddIndex = 0;
 
-		// prepare indirect commands buffer
-		for (auto &i : scene.meshForNode)
+		// prepare indirect commands buffer: one instanced draw per mesh, grouped by index format, 32-bit first
+		for (const bool index16 : {false, true})
 		{
-			const Mesh &mesh = meshData.meshes[i.second];
+			for (uint32_t m = 0; m != numMeshes_; m++)
+			{
+				const Mesh &mesh = meshData.meshes[m];
+
+				if (mesh.isIndex16() != index16)
+					continue;
+
+				const std::vector<uint32_t> &nodes = getNodesWithMesh(scene, m);
+
+				if (nodes.empty())
+					continue;
+
+				// LOD0 here, the culling passes select the LOD per frame from Mesh::lodError (see selectLOD())
+				indirectBuffer_.drawCommands_.push_back({
+					.count = mesh.getLODIndicesCount(0),
+					.instanceCount = (uint32_t)nodes.size(),
+					.firstIndex = mesh.indexOffset + mesh.lodOffset[0],
+					.baseVertex = (int32_t)mesh.vertexOffset,
+					.baseInstance = ddIndex,
+				});
+				std::fill_n(drawDataMesh_.begin() + ddIndex, nodes.size(), m);
+				for (uint32_t node : nodes)
+				{
+					*dd++ = {
+						.transformId = node,
+						.materialId = mesh.materialID,
+						.posOffset = {mesh.posOffset[0], mesh.posOffset[1], mesh.posOffset[2]},
+						.posScale = {mesh.posScale[0], mesh.posScale[1], mesh.posScale[2]},
+					};
+				}
+				ddIndex += (uint32_t)nodes.size();
+			}
+			if (!index16)
+				indirectBuffer_.numCommands32_ = (uint32_t)indirectBuffer_.drawCommands_.size();
+		}
 
-			const uint32_t lod = std::min(0u, mesh.lodCount - 1); // TODO: implement dynamic lod
+		LVK_ASSERT(ddIndex == numDrawData);
 
-			*cmd++ = {
-				.count = mesh.getLODIndicesCount(lod),
-				.instanceCount = 1,
-				.firstIndex = mesh.indexOffset, // + mesh.lodOffset[lod],
-				.baseVertex = (int32_t)mesh.vertexOffset,
-				.baseInstance = ddIndex++,
-			};
-			*dd++ = {
-				.transformId = i.first,
-				.materialId = mesh.materialID,
-			};
-		}
 		indirectBuffer_.uploadIndirectBuffer();
 
 		bufferDrawData_ = ctx->createBuffer(
 			{.usage = lvk::BufferUsageBits_Storage,
 			 .storage = lvk::StorageType_Device,
-			 .size = sizeof(DrawData) * numCommands,
+			 .size = sizeof(DrawData) * numDrawData,
 			 .data = drawData_.data(),
 			 .debugName = "Buffer: drawData"},
 			nullptr);
+
+		// compressed, partially corrupted or in-memory geometry without streaming: upload all the meshes right away, batch by batch
+		if (!streamGeometry && !uploadGeometry)
+		{
+			std::vector<uint32_t> meshOrder(numMeshes_);
+			std::iota(meshOrder.begin(), meshOrder.end(), 0u);
+			this->streamGeometry(meshOrder, std::numeric_limits<size_t>::max());
+			// the staging buffer holds all the geometry here, it is not kept for the meshes skipped as corrupted
+			releaseStaging();
+		}
 	}
 
 	void draw(
 		lvk::ICommandBuffer &buf, const VKPipeline11 &pipeline, const mat4 &view, const mat4 &proj,
 		lvk::TextureHandle texSkyboxIrradiance = {}, bool wireframe = false, const VKIndirectBuffer11 *indirectBuffer = nullptr) const
 	{
-		buf.cmdBindIndexBuffer(bufferIndices_, lvk::IndexFormat_UI32);
-		buf.cmdBindVertexBuffer(0, bufferVertices_);
+		buf.cmdBindVertexBuffer(0, pipeline.positionOnly_ ? bufferPositions_ : bufferVertices_);
 		buf.cmdBindRenderPipeline(wireframe ? pipeline.pipelineWireframe_ : pipeline.pipeline_);
 		buf.cmdBindDepthState({.compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true});
 		const struct
@@ -211,11 +342,7 @@ public:
 		};
 		static_assert(sizeof(pc) <= 128);
 		buf.cmdPushConstants(pc);
-		if (!indirectBuffer)
-			indirectBuffer = &indirectBuffer_;
-		buf.cmdDrawIndexedIndirectCount(
-			indirectBuffer->bufferIndirect_, sizeof(uint32_t), indirectBuffer->bufferIndirect_, 0, numMeshes_,
-			sizeof(DrawIndexedIndirectCommand));
+		drawIndirect(buf, indirectBuffer ? *indirectBuffer : indirectBuffer_, pipeline.positionOnly_);
 	}
 
 	void draw(
@@ -223,33 +350,450 @@ public:
 		const lvk::DepthState depthState = {.compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true}, bool wireframe = false,
 		const VKIndirectBuffer11 *indirectBuffer = nullptr) const
 	{
-		buf.cmdBindIndexBuffer(bufferIndices_, lvk::IndexFormat_UI32);
-		buf.cmdBindVertexBuffer(0, bufferVertices_);
+		buf.cmdBindVertexBuffer(0, pipeline.positionOnly_ ? bufferPositions_ : bufferVertices_);
 		buf.cmdBindRenderPipeline(wireframe ? pipeline.pipelineWireframe_ : pipeline.pipeline_);
 		buf.cmdBindDepthState(depthState);
 		buf.cmdPushConstants(pushConstants, pcSize);
-		if (!indirectBuffer)
-			indirectBuffer = &indirectBuffer_;
-		buf.cmdDrawIndexedIndirectCount(
-			indirectBuffer->bufferIndirect_, sizeof(uint32_t), indirectBuffer->bufferIndirect_, 0, numMeshes_,
-			sizeof(DrawIndexedIndirectCommand));
+		drawIndirect(buf, indirectBuffer ? *indirectBuffer : indirectBuffer_, pipeline.positionOnly_);
+	}
+
+	// one indirect draw per index format; the index buffer is rebound with the matching format and offset
+	void drawIndirect(lvk::ICommandBuffer &buf, const VKIndirectBuffer11 &indirectBuffer, bool positionOnly = false) const
+	{
+		const uint32_t numCommands = (uint32_t)indirectBuffer.drawCommands_.size();
+		const uint32_t numCommands32 = indirectBuffer.numCommands32_;
+
+		const lvk::BufferHandle bufferIndices = positionOnly ? bufferShadowIndices_ : bufferIndices_;
+
+		if (numCommands32)
+		{
+			buf.cmdBindIndexBuffer(bufferIndices, lvk::IndexFormat_UI32);
+			buf.cmdDrawIndexedIndirect(indirectBuffer.bufferIndirect_, sizeof(uint32_t), numCommands32, sizeof(DrawIndexedIndirectCommand));
+		}
+		if (numCommands > numCommands32)
+		{
+			buf.cmdBindIndexBuffer(bufferIndices, lvk::IndexFormat_UI16, indexOffset16_);
+			buf.cmdDrawIndexedIndirect(
+				indirectBuffer.bufferIndirect_, sizeof(uint32_t) + numCommands32 * sizeof(DrawIndexedIndirectCommand),
+				numCommands - numCommands32, sizeof(DrawIndexedIndirectCommand));
+		}
 	}
 
 	DrawIndexedIndirectCommand *getDrawIndexedIndirectCommandPtr() const { return indirectBuffer_.getDrawIndexedIndirectCommandPtr(); };
 
+	bool isMeshResident(uint32_t mesh) const { return meshResident_[mesh] != 0; }
+	bool isGeometryResident() const { return numResidentMeshes_ == numMeshes_; }
+	uint32_t getNumResidentMeshes() const { return numResidentMeshes_; }
+
+	// the number of instances to draw, zero while the geometry of the command is not resident
+	uint32_t getResidentInstanceCount(const DrawIndexedIndirectCommand &c) const
+	{
+		return isMeshResident(drawDataMesh_[c.baseInstance]) ? c.instanceCount : 0;
+	}
+
+	// Progressive geometry loading: upload the vertices, the positions and all LOD indices of the non-resident meshes in the order of
+	// meshOrder until maxBytes are uploaded (at least one mesh per call). Returns the number of meshes that became resident.
+	// The meshes of a call are decoded or copied into a staging buffer in parallel and copied with one dispatch per destination buffer
+	uint32_t streamGeometry(std::span<const uint32_t> meshOrder, size_t maxBytes)
+	{
+		if (!streamSource_)
+			return 0;
+
+		const MeshDataView &src = *streamSource_;
+		const size_t vertexSize = src.streams.getVertexSize();
+
+		uint32_t numStreamed = 0;
+		size_t numBytes = 0;
+		size_t next = 0;
+
+		// more than one batch only if more than kMaxMeshesPerBatch meshes fit into maxBytes
+		while (next != meshOrder.size() && numBytes < maxBytes)
+		{
+			stagedMeshes_.clear();
+			stagingOffset_ = 0;
+
+			for (; next != meshOrder.size() && numBytes < maxBytes && stagedMeshes_.size() != kMaxMeshesPerBatch; next++)
+			{
+				const uint32_t m = meshOrder[next];
+
+				if (meshResident_[m])
+					continue;
+
+				const Mesh &mesh = src.meshes[m];
+
+				if (!src.verifyMeshGeometry(mesh))
+				{
+					LLOGW("Corrupted geometry of mesh %u\n", m);
+					continue;
+				}
+
+				// LOD offsets are relative to indexOffset, so all LODs are one contiguous range
+				const size_t indicesSize = (size_t)mesh.lodOffset[mesh.lodCount] * (mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t));
+
+				StagedMesh &staged = stagedMeshes_.emplace_back();
+				staged.mesh = m;
+				reserveStaging(staged, CopyTarget_Vertices, (size_t)mesh.vertexOffset * vertexSize, (size_t)mesh.vertexCount * vertexSize);
+				reserveStaging(staged, CopyTarget_Indices, getIndexByteOffset(mesh), indicesSize);
+				reserveStaging(staged, CopyTarget_Positions, (size_t)mesh.vertexOffset * positionSize_, (size_t)mesh.vertexCount * positionSize_);
+				reserveStaging(staged, CopyTarget_ShadowIndices, getIndexByteOffset(mesh), indicesSize);
+
+				for (size_t size : staged.sizes)
+					numBytes += size;
+			}
+
+			if (stagedMeshes_.empty())
+				break;
+
+			beginStagingBatch(stagingOffset_ + kStagingOverheadPerBatch + stagedMeshes_.size() * CopyTarget_Count * sizeof(CopyRegion));
+
+			uint8_t *stagingPtr = ctx->getMappedPtr(staging_[currentStaging_].buffer);
+
+			tf::Taskflow taskflow;
+			taskflow.for_each_index(0u, (uint32_t)stagedMeshes_.size(), 1u, [&](uint32_t i)
+									{ stagedMeshes_[i].valid = stageMesh(src, stagedMeshes_[i], stagingPtr); });
+			streamExecutor_->run(taskflow).wait();
+
+			for (const StagedMesh &staged : stagedMeshes_)
+			{
+				if (!staged.valid)
+				{
+					LLOGW("Cannot decode mesh %u\n", staged.mesh);
+					continue;
+				}
+				for (uint32_t t = 0; t != CopyTarget_Count; t++)
+				{
+					if (staged.regions[t].numWords)
+						copyRegionsList_[t].push_back(staged.regions[t]);
+				}
+				// the draws reading the mesh are submitted after its copy, see barrierAfterCopy()
+				meshResident_[staged.mesh] = 1;
+				numResidentMeshes_++;
+				numStreamed++;
+			}
+
+			submitStagingBatch();
+		}
+
+		// everything is on the GPU, the view is not read anymore and its geometry can be evicted (see MeshDataView::evictGeometry()).
+		// The staging buffers are destroyed once their last copy is finished
+		if (isGeometryResident())
+		{
+			streamSource_ = nullptr;
+			releaseStaging();
+			streamExecutor_ = nullptr;
+		}
+
+		return numStreamed;
+	}
+
+	// the CPU materials and the texture file names are read only while the GPU materials and their textures are created
+	void releaseCPUMaterials()
+	{
+		materialsCPU_ = {};
+		textureFiles_ = {};
+	}
+
+private:
+	// matches the Region structure in CopyRegions.comp
+	struct CopyRegion
+	{
+		uint32_t srcWord;
+		uint32_t dstWord;
+		uint32_t numWords;
+		uint32_t firstMask;
+		uint32_t lastMask;
+		uint32_t padding[3];
+	};
+	static_assert(sizeof(CopyRegion) == 8 * sizeof(uint32_t));
+
+	// the destination buffers of streamGeometry(), one dispatch each
+	enum CopyTarget : uint8_t
+	{
+		CopyTarget_Vertices,
+		CopyTarget_Indices,
+		CopyTarget_Positions,
+		CopyTarget_ShadowIndices,
+		CopyTarget_Count,
+	};
+
+	// two host-visible staging buffers are used in turns, one batch is staged while the previous one is copied
+	struct StagingBuffer
+	{
+		lvk::Holder<lvk::BufferHandle> buffer;
+		size_t size = 0;
+		lvk::SubmitHandle submitHandle;
+	};
+
+	static constexpr size_t kStagingBufferSize = 32 * 1024 * 1024;
+	// the regions of a dispatch are the rows of its workgroup grid
+	static constexpr uint32_t kMaxMeshesPerBatch = 65535;
+	// the alignment of the region lists
+	static constexpr size_t kStagingOverheadPerBatch = CopyTarget_Count * 16;
+
+	// a mesh of the current batch of streamGeometry()
+	struct StagedMesh
+	{
+		uint32_t mesh = 0;
+		bool valid = false;
+		// the staged bytes of every CopyTarget
+		size_t offsets[CopyTarget_Count] = {};
+		size_t sizes[CopyTarget_Count] = {};
+		CopyRegion regions[CopyTarget_Count] = {};
+	};
+
+	static size_t getWordAlignedSize(size_t size) { return std::max((size + 3) & ~size_t(3), sizeof(uint32_t)); }
+
+	void beginStagingBatch(size_t minSize)
+	{
+		StagingBuffer &s = staging_[currentStaging_];
+
+		// the previous batch in this buffer might still be read by the GPU
+		if (!s.submitHandle.empty())
+			ctx->wait(s.submitHandle);
+		s.submitHandle = {};
+
+		if (s.size < minSize)
+		{
+			s.size = std::max(minSize, kStagingBufferSize);
+			s.buffer = ctx->createBuffer(
+				{.usage = lvk::BufferUsageBits_Storage,
+				 .storage = lvk::StorageType_HostVisible,
+				 .size = s.size,
+				 .debugName = "Buffer: geometry staging"},
+				nullptr);
+		}
+
+		for (std::vector<CopyRegion> &regions : copyRegionsList_)
+			regions.clear();
+	}
+
+	void releaseStaging()
+	{
+		for (StagingBuffer &s : staging_)
+			s = {};
+		for (std::vector<CopyRegion> &regions : copyRegionsList_)
+			regions = {};
+		stagedMeshes_ = {};
+	}
+
+	// The staged bytes start at the same byte of a 32-bit word as their destination. The copy shader moves whole words and masks the
+	// first and the last one, which can be shared with a neighbouring mesh
+	void reserveStaging(StagedMesh &staged, CopyTarget target, size_t dstOffset, size_t size)
+	{
+		const size_t shift = dstOffset & 3;
+		const size_t srcOffset = ((stagingOffset_ + 3) & ~size_t(3)) + shift;
+		const uint32_t end = (uint32_t)((dstOffset + size) & 3);
+
+		staged.offsets[target] = srcOffset;
+		staged.sizes[target] = size;
+		staged.regions[target] = {
+			.srcWord = (uint32_t)(srcOffset / sizeof(uint32_t)),
+			.dstWord = (uint32_t)(dstOffset / sizeof(uint32_t)),
+			.numWords = size ? (uint32_t)((shift + size + 3) / sizeof(uint32_t)) : 0,
+			.firstMask = ~0u << (8 * shift),
+			.lastMask = end ? (1u << (8 * end)) - 1 : ~0u,
+		};
+
+		stagingOffset_ = srcOffset + size;
+	}
+
+	// Decodes or copies the geometry of a mesh straight into its staging regions, called in parallel for all the meshes of a batch.
+	// Without depth-only geometry in the view it is built from the staged vertices and indices: lvk allocates host-visible buffers
+	// in cached memory when available, so they are cheap to read back
+	bool stageMesh(const MeshDataView &src, const StagedMesh &staged, uint8_t *stagingPtr) const
+	{
+		const Mesh &mesh = src.meshes[staged.mesh];
+
+		uint8_t *vertices = stagingPtr + staged.offsets[CopyTarget_Vertices];
+		uint8_t *indices = stagingPtr + staged.offsets[CopyTarget_Indices];
+		uint8_t *positions = stagingPtr + staged.offsets[CopyTarget_Positions];
+		uint8_t *shadowIndices = stagingPtr + staged.offsets[CopyTarget_ShadowIndices];
+
+		if (src.isCompressed())
+		{
+			if (!decodeMeshGeometry(src.compressed, mesh, indices, vertices))
+				return false;
+		}
+		else
+		{
+			copyStaged(vertices, getMeshVertices(src, mesh), staged.sizes[CopyTarget_Vertices]);
+			copyStaged(indices, getMeshIndices(src, mesh), staged.sizes[CopyTarget_Indices]);
+		}
+
+		if (src.hasDepthGeometry())
+		{
+			copyStaged(positions, getMeshPositions(src, mesh), staged.sizes[CopyTarget_Positions]);
+			copyStaged(shadowIndices, getMeshShadowIndices(src, mesh), staged.sizes[CopyTarget_ShadowIndices]);
+		}
+		else
+		{
+			fillPositionStream(src, staged.mesh, vertices, indices, positions, shadowIndices);
+		}
+
+		return true;
+	}
+
+	static void copyStaged(uint8_t *dst, const void *src, size_t size)
+	{
+		if (size)
+			memcpy(dst, src, size);
+	}
+
+	void submitStagingBatch()
+	{
+		StagingBuffer &s = staging_[currentStaging_];
+		uint8_t *stagingPtr = ctx->getMappedPtr(s.buffer);
+
+		// the region lists follow the staged data
+		size_t regionsOffset[CopyTarget_Count] = {};
+		for (uint32_t t = 0; t != CopyTarget_Count; t++)
+		{
+			stagingOffset_ = (stagingOffset_ + 15) & ~size_t(15);
+			regionsOffset[t] = stagingOffset_;
+			const size_t regionsSize = copyRegionsList_[t].size() * sizeof(CopyRegion);
+			memcpy(stagingPtr + stagingOffset_, copyRegionsList_[t].data(), regionsSize);
+			stagingOffset_ += regionsSize;
+		}
+		ctx->flushMappedMemory(s.buffer, 0, stagingOffset_);
+
+		const lvk::BufferHandle targets[CopyTarget_Count] = {bufferVertices_, bufferIndices_, bufferPositions_, bufferShadowIndices_};
+
+		lvk::ICommandBuffer &buf = ctx->acquireCommandBuffer();
+
+		buf.cmdBindComputePipeline(pipelineCopyRegions_);
+
+		for (uint32_t t = 0; t != CopyTarget_Count; t++)
+		{
+			const std::vector<CopyRegion> &regions = copyRegionsList_[t];
+
+			if (regions.empty())
+				continue;
+
+			uint32_t maxWords = 0;
+			for (const CopyRegion &r : regions)
+				maxWords = std::max(maxWords, r.numWords);
+
+			const struct
+			{
+				uint64_t regions;
+				uint64_t src;
+				uint64_t dst;
+			} pc = {
+				.regions = ctx->gpuAddress(s.buffer) + regionsOffset[t],
+				.src = ctx->gpuAddress(s.buffer),
+				.dst = ctx->gpuAddress(targets[t]),
+			};
+			buf.cmdPushConstants(pc);
+			// one row of workgroups per region, larger regions are looped over in the shader
+			buf.cmdDispatchThreadGroups(
+				{.width = std::min(1 + (maxWords - 1) / 64, 64u), .height = (uint32_t)regions.size()}, {.buffers = {targets[t]}});
+		}
+
+		barrierAfterCopy(buf);
+
+		s.submitHandle = ctx->submit(buf);
+		currentStaging_ = (currentStaging_ + 1) % (uint32_t)std::size(staging_);
+	}
+
+	// The draws read the copied geometry as vertex and index data, and the next batch can write to the last word of this one. lvk's
+	// Dependencies only order the preceding graphics stages before a dispatch
+	static void barrierAfterCopy(lvk::ICommandBuffer &buf)
+	{
+		const VkMemoryBarrier2 barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+							 VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		};
+		const VkDependencyInfo dependency = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &barrier,
+		};
+		vkCmdPipelineBarrier2(static_cast<lvk::CommandBuffer &>(buf).getVkCommandBuffer(), &dependency);
+	}
+
+	// byte offset of the first index of the mesh in bufferIndices_ and bufferShadowIndices_
+	size_t getIndexByteOffset(const Mesh &mesh) const
+	{
+		return mesh.isIndex16() ? indexOffset16_ + mesh.indexOffset * sizeof(uint16_t) : mesh.indexOffset * sizeof(uint32_t);
+	}
+
+	// the vertices and the indices of a mesh in an uncompressed view
+	static const uint8_t *getMeshVertices(const MeshDataView &src, const Mesh &mesh)
+	{
+		return src.isCompressed() ? nullptr : src.vertexData.data() + (size_t)mesh.vertexOffset * src.streams.getVertexSize();
+	}
+	static const void *getMeshIndices(const MeshDataView &src, const Mesh &mesh)
+	{
+		if (src.isCompressed())
+			return nullptr;
+		return mesh.isIndex16() ? (const void *)(src.indexData16.data() + mesh.indexOffset)
+								: (const void *)(src.indexData.data() + mesh.indexOffset);
+	}
+
+	// the depth-only geometry of a mesh stored in the view, see MeshDataView::hasDepthGeometry()
+	const uint8_t *getMeshPositions(const MeshDataView &src, const Mesh &mesh) const
+	{
+		return src.hasDepthGeometry() ? src.positions.data() + (size_t)mesh.vertexOffset * positionSize_ : nullptr;
+	}
+	static const void *getMeshShadowIndices(const MeshDataView &src, const Mesh &mesh)
+	{
+		if (!src.hasDepthGeometry())
+			return nullptr;
+		return mesh.isIndex16() ? (const void *)(src.shadowIndices16.data() + mesh.indexOffset)
+								: (const void *)(src.shadowIndices.data() + mesh.indexOffset);
+	}
+
+	// the positions and the shadow indices of one mesh, all LODs
+	void fillPositionStream(
+		const MeshDataView &src, uint32_t m, const uint8_t *vertices, const void *indices, uint8_t *positions, uint8_t *shadowIndices) const
+	{
+		const Mesh &mesh = src.meshes[m];
+
+		extractPositions(src.streams, vertices, mesh.vertexCount, positions);
+
+		generateShadowIndices(mesh, indices, positions, positionSize_, shadowIndices);
+	}
+
 public:
 	const std::unique_ptr<lvk::IContext> &ctx;
 
 	uint32_t numIndices_ = 0;
 	uint32_t numMeshes_ = 0;
 
+	// byte offset of the 16-bit indices in bufferIndices_
+	size_t indexOffset16_ = 0;
+
 	lvk::Holder<lvk::BufferHandle> bufferIndices_;
 	lvk::Holder<lvk::BufferHandle> bufferVertices_;
+	lvk::Holder<lvk::BufferHandle> bufferPositions_;
+	lvk::Holder<lvk::BufferHandle> bufferShadowIndices_;
 	lvk::Holder<lvk::BufferHandle> bufferTransforms_;
 	lvk::Holder<lvk::BufferHandle> bufferDrawData_;
 	lvk::Holder<lvk::BufferHandle> bufferMaterials_;
 
 	std::vector<DrawData> drawData_;
+	// the mesh drawn by every DrawData entry
+	std::vector<uint32_t> drawDataMesh_;
+
+	// progressive geometry loading, see streamGeometry()
+	const MeshDataView *streamSource_ = nullptr;
+	std::vector<uint8_t> meshResident_;
+	uint32_t numResidentMeshes_ = 0;
+	uint32_t positionSize_ = 0;
+	// staging of the streamed geometry, see submitStagingBatch()
+	StagingBuffer staging_[2];
+	uint32_t currentStaging_ = 0;
+	size_t stagingOffset_ = 0;
+	std::vector<StagedMesh> stagedMeshes_;
+	std::vector<CopyRegion> copyRegionsList_[CopyTarget_Count];
+	// decodes and stages the meshes of a batch in parallel
+	std::unique_ptr<tf::Executor> streamExecutor_;
+	lvk::Holder<lvk::ShaderModuleHandle> copyRegions_;
+	lvk::Holder<lvk::ComputePipelineHandle> pipelineCopyRegions_;
 
 	VKIndirectBuffer11 indirectBuffer_;
 
@@ -113,14 +113,16 @@ public:
 		lvk::StorageType indirectBufferStorage = lvk::StorageType_Device)
 		: VKMesh11(ctx, meshData, scene, indirectBufferStorage, false)
 	{
-		materialsGPU_.resize(materialsCPU_.size());
-
-		// construct Taskflow
-		taskflow_.for_each_index(0u, static_cast<uint32_t>(materialsCPU_.size()), 1u, [&](int i)
-								 { materialsGPU_[i] = convertToGPUMaterialLazy(ctx, materialsCPU_[i], textureFiles_, textureCache_, loadedTextureData_, loadingMutex_); });
+		startLoadingMaterials();
+	}
 
-		// start loading
-		executor_.run(taskflow_);
+	VKMesh11Lazy(
+		const std::unique_ptr<lvk::IContext> &ctx, const MeshDataView &meshData, const std::vector<Material> &materials,
+		const TextureFiles &textureFiles, const Scene &scene, lvk::StorageType indirectBufferStorage = lvk::StorageType_Device,
+		bool streamGeometry = false)
+		: VKMesh11(ctx, meshData, materials, textureFiles, scene, indirectBufferStorage, false, streamGeometry)
+	{
+		startLoadingMaterials();
 	}
 
 	bool processLoadedTextures()
@@ -133,6 +135,9 @@ public:
 
 			if (loadedTextureData_.empty())
 			{
+				// all the textures are on the GPU
+				if (!materialsCPU_.empty() && isLoadingFinished())
+					releaseCPUMaterials();
 				return false;
 			};
 
@@ -175,6 +180,24 @@ public:
 		return true;
 	}
 
+private:
+	void startLoadingMaterials()
+	{
+		materialsGPU_.resize(materialsCPU_.size());
+
+		// construct Taskflow
+		taskflow_.for_each_index(0u, static_cast<uint32_t>(materialsCPU_.size()), 1u, [&](int i)
+								 { materialsGPU_[i] = convertToGPUMaterialLazy(ctx, materialsCPU_[i], textureFiles_, textureCache_, loadedTextureData_, loadingMutex_); });
+
+		// start loading
+		loadingFuture_ = executor_.run(taskflow_);
+	}
+
+	bool isLoadingFinished() const
+	{
+		return loadingFuture_.valid() && loadingFuture_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
 public:
 	// multithreading
 	std::mutex loadingMutex_;
@@ -182,4 +205,5 @@ public:
 
 	tf::Taskflow taskflow_;
 	tf::Executor executor_{size_t(2)};
+	tf::Future<void> loadingFuture_;
 };
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "shared/Scene/Scene.h"
+#include "shared/Utils.h"
+
+#include <lvk/vulkan/VulkanClasses.h>
+
+#include <string.h>
+
+// GPU version of recalculateGlobalTransforms(): the per-level changed lists are uploaded and one compute dispatch per hierarchy level
+// writes the global transforms straight into a storage buffer (e.g. VKMesh11::bufferTransforms_).
+// The CPU function recalculateGlobalTransforms() remains the reference implementation.
+class VKGlobalTransforms11 final
+{
+public:
+	// matches the ChangedNode structure in GlobalTransforms.comp
+	struct ChangedNode
+	{
+		mat4 localTransform;
+		uint32_t node;
+		int32_t parent;
+		uint32_t padding[2];
+	};
+	static_assert(sizeof(ChangedNode) == sizeof(mat4) + 4 * sizeof(uint32_t));
+
+	VKGlobalTransforms11(const std::unique_ptr<lvk::IContext> &ctx, const Scene &scene, lvk::BufferHandle bufferGlobalTransforms)
+		: ctx_(ctx), bufferGlobalTransforms_(bufferGlobalTransforms), numNodes_((uint32_t)scene.hierarchy.size())
+	{
+		comp_ = loadShaderModule(ctx, "../../src/shaders/scenegraph/GlobalTransforms.comp");
+		pipeline_ = ctx->createComputePipeline({.smComp = comp_});
+
+		LVK_ASSERT(pipeline_.valid());
+
+		reserve(numNodes_);
+	}
+
+	// Consumes scene.changedAtThisFrame exactly like the CPU version, unless keepChangedLists is set (e.g. to run the CPU reference
+	// on the same lists afterwards). The CPU copy of scene.globalTransform is not updated
+	bool recalculateGlobalTransforms(lvk::ICommandBuffer &buf, Scene &scene, bool keepChangedLists = false)
+	{
+		changedNodes_.clear();
+
+		uint32_t levelOffsets[MAX_NODE_LEVEL + 1] = {};
+
+		for (int i = 0; i < MAX_NODE_LEVEL; i++)
+		{
+			levelOffsets[i] = (uint32_t)changedNodes_.size();
+
+			// the CPU version updates only the first changed node at the root level
+			const size_t numChanged = i == 0 ? std::min<size_t>(scene.changedAtThisFrame[0].size(), 1) : scene.changedAtThisFrame[i].size();
+
+			for (size_t n = 0; n != numChanged; n++)
+			{
+				const int c = scene.changedAtThisFrame[i][n];
+				changedNodes_.push_back({
+					.localTransform = scene.localTransform[c],
+					.node = (uint32_t)c,
+					.parent = i == 0 ? -1 : scene.hierarchy[c].parent,
+				});
+			}
+
+			if (!keepChangedLists)
+				scene.changedAtThisFrame[i].clear();
+		}
+		levelOffsets[MAX_NODE_LEVEL] = (uint32_t)changedNodes_.size();
+
+		if (changedNodes_.empty())
+			return false;
+
+		reserve(changedNodes_.size());
+
+		ctx_->upload(bufferChangedNodes_, changedNodes_.data(), changedNodes_.size() * sizeof(ChangedNode));
+
+		buf.cmdBindComputePipeline(pipeline_);
+
+		// every level depends on the global transforms written by the previous one
+		for (int i = 0; i < MAX_NODE_LEVEL; i++)
+		{
+			const uint32_t numChanged = levelOffsets[i + 1] - levelOffsets[i];
+
+			if (!numChanged)
+				continue;
+
+			const struct
+			{
+				uint64_t changed;
+				uint64_t globalTransforms;
+				uint32_t firstNode;
+				uint32_t numNodes;
+			} pc = {
+				.changed = ctx_->gpuAddress(bufferChangedNodes_),
+				.globalTransforms = ctx_->gpuAddress(bufferGlobalTransforms_),
+				.firstNode = levelOffsets[i],
+				.numNodes = numChanged,
+			};
+			buf.cmdPushConstants(pc);
+			buf.cmdDispatchThreadGroups({.width = 1 + (numChanged - 1) / 64}, {.buffers = {bufferGlobalTransforms_}});
+			barrierAfterDispatch(buf);
+		}
+
+		return true;
+	}
+
+	// Run the GPU and the CPU paths on the same changed lists and compare the results bit-by-bit.
+	// Works with any lvk::IContext, including a headless one on a software implementation (e.g. lavapipe).
+	// Both scene.changedAtThisFrame and scene.globalTransform are updated by the CPU reference
+	bool validate(Scene &scene)
+	{
+		std::vector<int> changed[MAX_NODE_LEVEL];
+		for (int i = 0; i < MAX_NODE_LEVEL; i++)
+			changed[i] = scene.changedAtThisFrame[i];
+
+		// both paths read the parent transforms from the same starting point
+		ctx_->upload(bufferGlobalTransforms_, scene.globalTransform.data(), scene.globalTransform.size() * sizeof(mat4));
+
+		lvk::ICommandBuffer &buf = ctx_->acquireCommandBuffer();
+		recalculateGlobalTransforms(buf, scene, true);
+		ctx_->wait(ctx_->submit(buf));
+
+		::recalculateGlobalTransforms(scene);
+
+		std::vector<mat4> gpuTransforms(scene.globalTransform.size());
+		ctx_->download(bufferGlobalTransforms_, gpuTransforms.data(), gpuTransforms.size() * sizeof(mat4), 0);
+
+		uint32_t numMismatches = 0;
+
+		for (int i = 0; i < MAX_NODE_LEVEL; i++)
+		{
+			for (int c : changed[i])
+			{
+				if (memcmp(&gpuTransforms[c], &scene.globalTransform[c], sizeof(mat4)) != 0)
+				{
+					if (!numMismatches)
+						LLOGW("Global transform mismatch: node %i at level %i\n", c, i);
+					numMismatches++;
+				}
+			}
+		}
+
+		if (numMismatches)
+			LLOGW("GPU global transforms: %u mismatches\n", numMismatches);
+
+		return numMismatches == 0;
+	}
+
+private:
+	// Every level reads the parent transforms written by the previous one, and the draws read the last level. lvk's Dependencies only
+	// order the preceding graphics stages before a dispatch, so the compute writes are made visible here
+	static void barrierAfterDispatch(lvk::ICommandBuffer &buf)
+	{
+		const VkMemoryBarrier2 barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		};
+		const VkDependencyInfo dependency = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &barrier,
+		};
+		vkCmdPipelineBarrier2(static_cast<lvk::CommandBuffer &>(buf).getVkCommandBuffer(), &dependency);
+	}
+
+	void reserve(size_t numChangedNodes)
+	{
+		if (numChangedNodes <= capacity_ && !bufferChangedNodes_.empty())
+			return;
+
+		capacity_ = std::max(numChangedNodes, (size_t)1);
+
+		bufferChangedNodes_ = ctx_->createBuffer(
+			{.usage = lvk::BufferUsageBits_Storage,
+			 .storage = lvk::StorageType_Device,
+			 .size = capacity_ * sizeof(ChangedNode),
+			 .debugName = "Buffer: changed nodes"},
+			nullptr);
+	}
+
+public:
+	const std::unique_ptr<lvk::IContext> &ctx_;
+
+	lvk::BufferHandle bufferGlobalTransforms_;
+	lvk::Holder<lvk::BufferHandle> bufferChangedNodes_;
+
+	lvk::Holder<lvk::ShaderModuleHandle> comp_;
+	lvk::Holder<lvk::ComputePipelineHandle> pipeline_;
+
+	uint32_t numNodes_ = 0;
+	size_t capacity_ = 0;
+
+	std::vector<ChangedNode> changedNodes_;
+};
@@ -4,6 +4,11 @@
 #include "Bistro.h"
 #include "Skybox.h"
 #include "VKMesh11Lazy.h"
+#include "VKTransforms11.h"
+
+#include "shared/Scene/ClusterCulling.h"
+#include "shared/Scene/MeshReport.h"
+#include "shared/Scene/SpatialHash.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -18,6 +23,8 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+#include <tuple>
+
 #define DEMO_TEXTURE_MAX_SIZE 2048
 #define DEMO_TEXTURE_CACHE_FOLDER ".cache/out_textures_11/"
 #define fileNameCachedMeshes ".cache/ch11_bistro.meshes"
@@ -49,10 +56,25 @@ enum CullingMode
 	CullingMode_None = 0,
 	CullingMode_CPU = 1,
 	CullingMode_GPU = 2,
+	CullingMode_Meshlets = 3,
 };
 mat4 cullingView = mat4(1.0f);
 int cullingMode = CullingMode_CPU;
 bool freezeCullingView = false;
+bool cullBackfaceMeshlets = false; // all pipelines use CullMode_None, so this is not safe for double-sided materials
+bool enableDynamicLOD = true;
+float lodMaxPixelError = 1.0f;
+// progressive geometry loading: the first frame needs only the mesh records and the bounding volumes
+bool streamGeometry = true;
+const size_t kStreamingBytesPerFrame = 16 * 1024 * 1024;
+// residency: once all the geometry is on the GPU, the mapped indices and vertices are evicted from RAM (they are paged back in from the
+// .meshes file if read again); the mesh records and the bounding volumes used by culling and LOD selection stay resident
+bool evictUploadedGeometry = true;
+// dynamic nodes: the mesh nodes marked as dynamic in the scene (see isNodeDynamic()) are animated, their global transforms are recalculated every frame either by the
+// compute shader (VKGlobalTransforms11) writing straight into VKMesh11::bufferTransforms_, or on the CPU and uploaded
+bool animateDynamicNodes = false;
+bool gpuGlobalTransforms = true;
+float dynamicNeighbourRadius = 5.0f;
 
 struct LightParams
 {
@@ -64,11 +86,16 @@ struct LightParams
 	bool operator==(const LightParams &) const = default;
 } light;
 
-int main()
+int main(int argc, char *argv[])
 {
-	MeshData meshData;
+	// report mode, no window or GPU is involved: Nugie_Engine --report <file.meshes> <report.json>
+	if (argc == 4 && !strcmp(argv[1], "--report"))
+		return writeMeshReport(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	MeshDataView meshView;
+	MeshData meshData; // materials only, the geometry is memory-mapped by meshView
 	Scene scene;
-	loadBistro(meshData, scene);
+	loadBistro(meshView, meshData, scene);
 
 	VulkanApp app({
 		.initialCameraPos = vec3(-18.621f, 4.621f, -6.359f),
@@ -256,15 +283,16 @@ int main()
 	const Skybox skyBox(
 		ctx, "../../data/immenstadter_horn_2k_prefilter.ktx", "../../data/immenstadter_horn_2k_irradiance.ktx", kOffscreenFormat, app.getDepthFormat(),
 		kNumSamples);
-	VKMesh11Lazy mesh(ctx, meshData, scene);
+	VKMesh11Lazy mesh(ctx, meshView, meshData.materials, meshData.textureFiles, scene, lvk::StorageType_Device, streamGeometry);
 	const VKPipeline11 pipelineOpaque(
-		ctx, meshData.streams, kOffscreenFormat, app.getDepthFormat(), kNumSamples,
+		ctx, meshView.streams, kOffscreenFormat, app.getDepthFormat(), kNumSamples,
 		loadShaderModule(ctx, "../../src/shaders/main.vert"), loadShaderModule(ctx, "../../src/shaders/oit/opaque.frag"));
 	const VKPipeline11 pipelineTransparent(
-		ctx, meshData.streams, kOffscreenFormat, app.getDepthFormat(), kNumSamples,
+		ctx, meshView.streams, kOffscreenFormat, app.getDepthFormat(), kNumSamples,
 		loadShaderModule(ctx, "../../src/shaders/main.vert"), loadShaderModule(ctx, "../../src/shaders/oit/transparent.frag"));
+	// depth-only: positions and shadow indices, see VKMesh11::bufferPositions_
 	const VKPipeline11 pipelineShadow(
-		ctx, meshData.streams, lvk::Format_Invalid, ctx->getFormat(texShadowMap), 1,
+		ctx, getPositionStream(meshView.streams), lvk::Format_Invalid, ctx->getFormat(texShadowMap), 1,
 		loadShaderModule(ctx, "../../src/shaders/directional_shadow/shadow.vert"),
 		loadShaderModule(ctx, "../../src/shaders/directional_shadow/shadow.frag"));
 
@@ -347,15 +375,41 @@ int main()
     if (key == GLFW_KEY_C)
       cullingMode = CullingMode_CPU;
     if (key == GLFW_KEY_G)
-      cullingMode = CullingMode_GPU; });
-
-	// pretransform bounding boxes to world space
-	std::vector<BoundingBox> reorderedBoxes;
-	reorderedBoxes.resize(scene.globalTransform.size());
+      cullingMode = CullingMode_GPU;
+    if (key == GLFW_KEY_M)
+      cullingMode = CullingMode_Meshlets; });
+
+	// pretransform bounding volumes to world space
+	std::vector<BoundingBox> reorderedBoxes(scene.globalTransform.size());
+	std::vector<BoundingSphere> reorderedSpheres(scene.globalTransform.size());
+	std::vector<OrientedBoundingBox> reorderedOBBs(scene.globalTransform.size());
+	auto updateBoundingVolumes = [&](uint32_t node, uint32_t meshId)
+	{
+		const mat4 &t = scene.globalTransform[node];
+		reorderedSpheres[node] = meshView.spheres[meshId].getTransformed(t);
+		reorderedOBBs[node] = meshView.obbs[meshId].getTransformed(t);
+		// both boxes contain the mesh, and so does their intersection
+		const BoundingBox a = meshView.boxes[meshId].getTransformed(t);
+		const BoundingBox b = reorderedOBBs[node].getBoundingBox();
+		reorderedBoxes[node] = BoundingBox(glm::max(a.min_, b.min_), glm::min(a.max_, b.max_));
+	};
 	for (auto &p : scene.meshForNode)
+		updateBoundingVolumes(p.first, p.second);
+
+	// the cheapest test first: a sphere entirely inside or outside of the frustum needs no box test
+	auto isNodeInFrustum = [&reorderedSpheres, &reorderedOBBs](vec4 *frustumPlanes, vec4 *frustumCorners, uint32_t node) -> bool
 	{
-		reorderedBoxes[p.first] = meshData.boxes[p.second].getTransformed(scene.globalTransform[p.first]);
-	}
+		const int sphere = classifySphereInFrustum(frustumPlanes, reorderedSpheres[node].center, reorderedSpheres[node].radius);
+		return sphere > 0 || (sphere == 0 && isOBBInFrustum(frustumPlanes, frustumCorners, reorderedOBBs[node]));
+	};
+
+	// all instances of a command share its indices, so the command gets the finest LOD required by its instances
+	auto setCommandLOD = [&scene, &meshView](DrawIndexedIndirectCommand *cmd, uint32_t transformId, uint32_t lod)
+	{
+		const Mesh &m = meshView.meshes[scene.meshForNode[transformId]];
+		cmd->count = m.getLODIndicesCount(lod);
+		cmd->firstIndex = m.indexOffset + m.lodOffset[lod];
+	};
 
 	lvk::Holder<lvk::BufferHandle> bufferAABBs = ctx->createBuffer({
 		.usage = lvk::BufferUsageBits_Storage,
@@ -365,6 +419,78 @@ int main()
 		.debugName = "Buffer: AABBs",
 	});
 
+	// culling, LOD selection and streaming read the CPU copy of the global transforms of the mesh nodes, see updateMeshGlobalTransform()
+	VKGlobalTransforms11 gpuTransforms(ctx, scene, mesh.bufferTransforms_);
+
+	std::vector<int> dynamicNodes;
+	std::vector<mat4> dynamicNodesLocalTransforms;
+	for (auto &p : scene.meshForNode)
+	{
+		if (isNodeDynamic(scene, p.first))
+		{
+			dynamicNodes.push_back((int)p.first);
+			dynamicNodesLocalTransforms.push_back(scene.localTransform[p.first]);
+		}
+	}
+
+	// the moved nodes of the current frame, including their descendants
+	std::vector<int> movedNodes;
+	float animationTime = 0.0f;
+
+	// everything the animation can move: the dynamic nodes and their subtrees
+	std::vector<uint8_t> isDynamicNode(scene.hierarchy.size(), 0);
+	{
+		std::vector<int> stack = dynamicNodes;
+		while (!stack.empty())
+		{
+			const int node = stack.back();
+			stack.pop_back();
+			if (isDynamicNode[node])
+				continue;
+			isDynamicNode[node] = 1;
+			for (int c = scene.hierarchy[node].firstChild; c != -1; c = scene.hierarchy[c].nextSibling)
+				stack.push_back(c);
+		}
+	}
+
+	// With GPU global transforms only the moved nodes with meshes get their CPU copy recalculated, from the closest ancestor that is
+	// up to date: a static node or a mesh node. movedNodes is sorted by level, so the moved mesh ancestors are recalculated first
+	auto updateMeshGlobalTransform = [&](int node)
+	{
+		mat4 t = scene.localTransform[node];
+		int p = scene.hierarchy[node].parent;
+		for (; p != -1 && isDynamicNode[p] && !scene.meshForNode.contains((uint32_t)p); p = scene.hierarchy[p].parent)
+			t = scene.localTransform[p] * t;
+		scene.globalTransform[node] = p != -1 ? scene.globalTransform[p] * t : t;
+	};
+
+	// Loose grid for the moving nodes, updated incrementally from the moved nodes. The static nodes keep their prebuilt bounding volumes
+	SpatialHash dynamicHash;
+	{
+		std::vector<int> nodes;
+		float sumSizes = 0.0f;
+		uint32_t numBoxes = 0;
+		for (size_t node = 0; node != isDynamicNode.size(); node++)
+		{
+			if (!isDynamicNode[node])
+				continue;
+			nodes.push_back((int)node);
+			if (scene.meshForNode.contains((uint32_t)node))
+			{
+				const vec3 size = reorderedBoxes[node].getSize();
+				sumSizes += std::max(std::max(size.x, size.y), size.z);
+				numBoxes++;
+			}
+		}
+		// twice the average size: most of the nodes fit into the loose cells, only a few end up in the oversized list
+		spatialHashInit(dynamicHash, numBoxes ? std::max(2.0f * sumSizes / (float)numBoxes, 0.01f) : 1.0f, scene.hierarchy.size());
+		updateSpatialHash(dynamicHash, scene, meshView.boxes, nodes);
+	}
+
+	std::vector<uint32_t> visibleDynamicNodes;
+	std::vector<uint8_t> isDynamicNodeVisible(scene.hierarchy.size(), 0);
+	std::vector<uint32_t> nearbyDynamicNodes;
+
 	// create the scene AABB in world space
 	BoundingBox bigBoxWS = reorderedBoxes.front();
 	for (const auto &b : reorderedBoxes)
@@ -382,6 +508,7 @@ int main()
 	} emptyCullingData;
 
 	int numVisibleMeshes = 0; // CPU
+	ClusterCullingStats meshletStats;
 
 	// round-robin
 	const lvk::BufferDesc cullingDataDesc = {
@@ -399,16 +526,29 @@ int main()
 
 	uint32_t currentBufferId = 0; // for culling stats
 
+	// The CPU and GPU culling passes compact the visible instances of every opaque command to the front of its DrawData range and set
+	// instanceCount to their number. The transparent ranges are never culled and remain a copy of VKMesh11::drawData_
+	lvk::Holder<lvk::BufferHandle> bufferVisibleDrawData = ctx->createBuffer({
+		.usage = lvk::BufferUsageBits_Storage,
+		.storage = lvk::StorageType_HostVisible,
+		.size = mesh.drawData_.size() * sizeof(DrawData),
+		.data = mesh.drawData_.data(),
+		.debugName = "Buffer: visible drawData",
+	});
+
 	struct
 	{
 		uint64_t commands;
 		uint64_t drawData;
 		uint64_t AABBs;
 		uint64_t meshes;
+		uint64_t instanceCounts;
+		uint64_t visibleDrawData;
 	} pcCulling = {
 		.commands = 0,
 		.drawData = ctx->gpuAddress(mesh.bufferDrawData_),
 		.AABBs = ctx->gpuAddress(bufferAABBs),
+		.visibleDrawData = ctx->gpuAddress(bufferVisibleDrawData),
 	};
 
 	VKIndirectBuffer11 meshesOpaque(ctx, mesh.numMeshes_, lvk::StorageType_HostVisible);
@@ -427,6 +567,68 @@ int main()
 		meshesTransparent, [&isTransparent](const DrawIndexedIndirectCommand &c) -> bool
 		{ return isTransparent(c); });
 
+	// VKMesh11 keeps its own copy of the materials until all the textures are loaded
+	meshData = MeshData();
+
+	auto evictGeometry = [&meshView]()
+	{
+		if (!evictUploadedGeometry)
+			return;
+		const size_t numBytes = meshView.evictGeometry();
+		if (numBytes)
+			printf("Evicted %.1f MB of uploaded geometry from RAM\n", (double)numBytes / (1024.0 * 1024.0));
+	};
+
+	// the culling passes overwrite instanceCount, the original number of instances of every command is kept separately
+	std::vector<uint32_t> opaqueInstanceCounts;
+	opaqueInstanceCounts.reserve(meshesOpaque.drawCommands_.size());
+	for (const DrawIndexedIndirectCommand &c : meshesOpaque.drawCommands_)
+		opaqueInstanceCounts.push_back(c.instanceCount);
+
+	uint32_t numTransparentInstances = 0;
+	for (const DrawIndexedIndirectCommand &c : meshesTransparent.drawCommands_)
+		numTransparentInstances += c.instanceCount;
+
+	lvk::Holder<lvk::BufferHandle> bufferInstanceCounts = ctx->createBuffer({
+		.usage = lvk::BufferUsageBits_Storage,
+		.storage = lvk::StorageType_Device,
+		.size = std::max(opaqueInstanceCounts.size(), (size_t)1) * sizeof(uint32_t),
+		.data = opaqueInstanceCounts.data(),
+		.debugName = "Buffer: instance counts",
+	});
+
+	pcCulling.instanceCounts = ctx->gpuAddress(bufferInstanceCounts);
+
+	// Draws whose geometry is not resident yet get zero instances. The CPU copies of the commands keep the real counts and
+	// the opaque commands are masked every frame by the culling passes
+	auto maskNonResidentDraws = [&]()
+	{
+		auto getInstanceCount = [&mesh](const DrawIndexedIndirectCommand &c) { return mesh.getResidentInstanceCount(c); };
+		mesh.indirectBuffer_.uploadIndirectBuffer(getInstanceCount);
+		meshesTransparent.uploadIndirectBuffer(getInstanceCount);
+		for (size_t i = 0; i != meshesOpaque.drawCommands_.size(); i++)
+			opaqueInstanceCounts[i] = getInstanceCount(meshesOpaque.drawCommands_[i]);
+		if (!opaqueInstanceCounts.empty())
+			ctx->upload(bufferInstanceCounts, opaqueInstanceCounts.data(), opaqueInstanceCounts.size() * sizeof(uint32_t));
+	};
+
+	if (!mesh.isGeometryResident())
+		maskNonResidentDraws();
+	else
+		evictGeometry();
+
+	// meshes sorted by streaming priority: visible first, then by the distance to the camera
+	std::vector<std::tuple<bool, float, uint32_t>> streamingPriorities;
+	std::vector<uint32_t> streamingOrder;
+
+	// one command per visible meshlet of every opaque instance, rebuilt every frame by the CPU cluster culler
+	uint32_t numOpaqueMeshlets = 0;
+	for (const DrawIndexedIndirectCommand &c : meshesOpaque.drawCommands_)
+		numOpaqueMeshlets += c.instanceCount * meshView.meshes[scene.meshForNode[mesh.drawData_[c.baseInstance].transformId]].meshletCount;
+
+	VKIndirectBuffer11 meshletsOpaque(ctx, std::max(numOpaqueMeshlets, 1u), lvk::StorageType_HostVisible);
+	meshletsOpaque.drawCommands_.clear();
+
 	struct TransparentFragment
 	{
 		uint64_t rgba; // f16vec4
@@ -582,6 +784,33 @@ int main()
     getFrustumPlanes(proj * cullingView, cullingData.frustumPlanes);
     getFrustumCorners(proj * cullingView, cullingData.frustumCorners);
 
+    bool geometryStreamed = false;
+
+    if (!mesh.isGeometryResident()) {
+      const vec3 cameraPos = app.camera_.getPosition();
+      streamingPriorities.clear();
+      for (uint32_t m = 0; m != mesh.numMeshes_; m++) {
+        if (mesh.isMeshResident(m))
+          continue;
+        bool isHidden  = true;
+        float distance = std::numeric_limits<float>::max();
+        for (uint32_t node : getNodesWithMesh(scene, m)) {
+          isHidden = isHidden && !isNodeInFrustum(cullingData.frustumPlanes, cullingData.frustumCorners, node);
+          distance = std::min(distance, glm::length(reorderedSpheres[node].center - cameraPos) - reorderedSpheres[node].radius);
+        }
+        streamingPriorities.emplace_back(isHidden, distance, m);
+      }
+      std::sort(streamingPriorities.begin(), streamingPriorities.end());
+      streamingOrder.clear();
+      for (const auto& p : streamingPriorities)
+        streamingOrder.push_back(std::get<2>(p));
+      geometryStreamed = mesh.streamGeometry(streamingOrder, kStreamingBytesPerFrame) > 0;
+      if (geometryStreamed)
+        maskNonResidentDraws();
+      if (mesh.isGeometryResident())
+        evictGeometry();
+    }
+
     // light
     const glm::mat4 rot1 = glm::rotate(mat4(1.f), glm::radians(light.theta), glm::vec3(0, 1, 0));
     const glm::mat4 rot2 = glm::rotate(rot1, glm::radians(light.phi), glm::vec3(1, 0, 0));
@@ -592,44 +821,165 @@ int main()
     const BoundingBox boxLS = bigBoxWS.getTransformed(lightView);
     const mat4 lightProj    = glm::orthoLH_ZO(boxLS.min_.x, boxLS.max_.x, boxLS.min_.y, boxLS.max_.y, boxLS.max_.z, boxLS.min_.z);
 
+    // dynamic LOD from the projected simplification error, the LOD follows the culling view
+    const vec3 lodCameraPos  = vec3(glm::inverse(cullingView)[3]);
+    const float lodProjScale = getLODProjectionScale(proj, static_cast<float>(sizeFb.height));
+
+    auto getInstanceLOD = [&](uint32_t transformId) -> uint32_t {
+      if (!enableDynamicLOD)
+        return 0;
+      const uint32_t meshId = scene.meshForNode[transformId];
+      return selectLOD(
+          meshView.meshes[meshId], meshView.spheres[meshId], scene.globalTransform[transformId], lodCameraPos, lodProjScale,
+          lodMaxPixelError);
+    };
+    auto getCommandLOD = [&](const DrawIndexedIndirectCommand& c) -> uint32_t {
+      uint32_t lod = kMaxLODs;
+      for (uint32_t k = 0; k != c.instanceCount && lod; k++)
+        lod = std::min(lod, getInstanceLOD(mesh.drawData_[c.baseInstance + k].transformId));
+      return lod;
+    };
+
+    // dynamic nodes bob proportionally to their size, markAsChanged() adds all their descendants
+    movedNodes.clear();
+    if (animateDynamicNodes) {
+      animationTime += deltaSeconds;
+      for (size_t i = 0; i != dynamicNodes.size(); i++) {
+        const int node     = dynamicNodes[i];
+        const float radius = meshView.spheres[scene.meshForNode[node]].radius;
+        const float offset = 0.25f * radius * sinf(2.0f * animationTime + static_cast<float>(i));
+        scene.localTransform[node] = glm::translate(mat4(1.0f), vec3(0.0f, offset, 0.0f)) * dynamicNodesLocalTransforms[i];
+        markAsChanged(scene, node);
+      }
+    }
+    for (const std::vector<int>& changed : scene.changedAtThisFrame)
+      movedNodes.insert(movedNodes.end(), changed.begin(), changed.end());
+
     lvk::ICommandBuffer& buf = ctx->acquireCommandBuffer();
     {
       clearTransparencyBuffers(buf);
 
+      // global transforms of the moved nodes, then their world-space bounding volumes for culling
+      if (!movedNodes.empty()) {
+        if (gpuGlobalTransforms) {
+          gpuTransforms.recalculateGlobalTransforms(buf, scene);
+          for (int node : movedNodes) {
+            if (scene.meshForNode.contains(static_cast<uint32_t>(node)))
+              updateMeshGlobalTransform(node);
+          }
+        } else {
+          recalculateGlobalTransforms(scene);
+        }
+        const auto [minNode, maxNode] = std::minmax_element(movedNodes.begin(), movedNodes.end());
+        const size_t firstNode        = static_cast<size_t>(*minNode);
+        const size_t numNodes         = static_cast<size_t>(*maxNode - *minNode) + 1;
+        if (!gpuGlobalTransforms)
+          ctx->upload(mesh.bufferTransforms_, &scene.globalTransform[firstNode], numNodes * sizeof(mat4), firstNode * sizeof(mat4));
+        for (int node : movedNodes) {
+          const auto it = scene.meshForNode.find(static_cast<uint32_t>(node));
+          if (it != scene.meshForNode.end())
+            updateBoundingVolumes(it->first, it->second);
+        }
+        ctx->upload(bufferAABBs, &reorderedBoxes[firstNode], numNodes * sizeof(BoundingBox), firstNode * sizeof(BoundingBox));
+        updateSpatialHash(dynamicHash, scene, meshView.boxes, movedNodes);
+      }
+
+      // the dynamic nodes are culled by the spatial hash, whole cells at once
+      if (cullingMode == CullingMode_CPU || cullingMode == CullingMode_Meshlets) {
+        for (uint32_t node : visibleDynamicNodes)
+          isDynamicNodeVisible[node] = 0;
+        visibleDynamicNodes.clear();
+        spatialHashQueryFrustum(dynamicHash, cullingData.frustumPlanes, cullingData.frustumCorners, visibleDynamicNodes);
+        for (uint32_t node : visibleDynamicNodes)
+          isDynamicNodeVisible[node] = 1;
+      }
+      auto isNodeVisible = [&](uint32_t node) -> bool {
+        return isDynamicNode[node] ? isDynamicNodeVisible[node] != 0
+                                   : isNodeInFrustum(cullingData.frustumPlanes, cullingData.frustumCorners, node);
+      };
+
       // cull scene (we cull only opaque meshes)
       if (cullingMode == CullingMode_None) {
         numVisibleMeshes                = static_cast<uint32_t>(scene.meshForNode.size()); // all meshes
         DrawIndexedIndirectCommand* cmd = meshesOpaque.getDrawIndexedIndirectCommandPtr();
         for (auto& c : meshesOpaque.drawCommands_) {
-          (cmd++)->instanceCount = 1;
+          setCommandLOD(cmd, mesh.drawData_[c.baseInstance].transformId, getCommandLOD(c));
+          (cmd++)->instanceCount = mesh.getResidentInstanceCount(c);
         }
         ctx->flushMappedMemory(meshesOpaque.bufferIndirect_, 0, meshesOpaque.drawCommands_.size() * sizeof(DrawIndexedIndirectCommand));
       } else if (cullingMode == CullingMode_CPU) {
-        numVisibleMeshes =
-            static_cast<uint32_t>(meshesTransparent.drawCommands_.size()); // all transparent meshes are visible - we don't cull them
+        numVisibleMeshes = numTransparentInstances; // all transparent meshes are visible - we don't cull them
 
         DrawIndexedIndirectCommand* cmd = meshesOpaque.getDrawIndexedIndirectCommandPtr();
+        DrawData* visibleDrawData       = reinterpret_cast<DrawData*>(ctx->getMappedPtr(bufferVisibleDrawData));
         for (size_t i = 0; i != meshesOpaque.drawCommands_.size(); i++) {
-          const BoundingBox box  = reorderedBoxes[mesh.drawData_[cmd->baseInstance].transformId];
-          const uint32_t count   = isBoxInFrustum(cullingData.frustumPlanes, cullingData.frustumCorners, box) ? 1 : 0;
-          (cmd++)->instanceCount = count;
-          numVisibleMeshes += count;
+          const DrawIndexedIndirectCommand& c = meshesOpaque.drawCommands_[i];
+          const uint32_t numInstances         = mesh.getResidentInstanceCount(c);
+          uint32_t numVisible                 = 0;
+          uint32_t lod                        = kMaxLODs;
+          for (uint32_t k = 0; k != numInstances; k++) {
+            const DrawData& dd = mesh.drawData_[c.baseInstance + k];
+            if (isNodeVisible(dd.transformId)) {
+              visibleDrawData[c.baseInstance + numVisible++] = dd;
+              lod = std::min(lod, getInstanceLOD(dd.transformId));
+            }
+          }
+          setCommandLOD(cmd, mesh.drawData_[c.baseInstance].transformId, numVisible ? lod : 0);
+          (cmd++)->instanceCount = numVisible;
+          numVisibleMeshes += numVisible;
         }
         ctx->flushMappedMemory(meshesOpaque.bufferIndirect_, 0, meshesOpaque.drawCommands_.size() * sizeof(DrawIndexedIndirectCommand));
+        ctx->flushMappedMemory(bufferVisibleDrawData, 0, mesh.drawData_.size() * sizeof(DrawData));
       } else if (cullingMode == CullingMode_GPU) {
+        // the compute shader overwrites only instanceCount
+        DrawIndexedIndirectCommand* cmd = meshesOpaque.getDrawIndexedIndirectCommandPtr();
+        for (auto& c : meshesOpaque.drawCommands_) {
+          setCommandLOD(cmd++, mesh.drawData_[c.baseInstance].transformId, getCommandLOD(c));
+        }
+        ctx->flushMappedMemory(meshesOpaque.bufferIndirect_, 0, meshesOpaque.drawCommands_.size() * sizeof(DrawIndexedIndirectCommand));
         buf.cmdBindComputePipeline(pipelineCulling);
         pcCulling.meshes   = ctx->gpuAddress(bufferCullingData[currentBufferId]);
         pcCulling.commands = ctx->gpuAddress(meshesOpaque.bufferIndirect_);
-        cullingData.numVisibleMeshes =
-            static_cast<uint32_t>(meshesTransparent.drawCommands_.size()); // all transparent meshes are visible - we don't cull them
+        cullingData.numVisibleMeshes = numTransparentInstances; // all transparent meshes are visible - we don't cull them
         buf.cmdPushConstants(pcCulling);
         buf.cmdUpdateBuffer(bufferCullingData[currentBufferId], cullingData);
         buf.cmdDispatchThreadGroups(
-            { 1 + cullingData.numMeshesToCull / 64 }, { .buffers = { lvk::BufferHandle(meshesOpaque.bufferIndirect_) } });
+            { 1 + cullingData.numMeshesToCull / 64 },
+            { .buffers = { lvk::BufferHandle(meshesOpaque.bufferIndirect_), lvk::BufferHandle(bufferVisibleDrawData) } });
+      } else if (cullingMode == CullingMode_Meshlets) {
+        ClusterCullingView clusterView = {
+          .cameraPos             = vec3(glm::inverse(cullingView)[3]),
+          .enableBackfaceCulling = cullBackfaceMeshlets,
+        };
+        memcpy(clusterView.frustumPlanes, cullingData.frustumPlanes, sizeof(clusterView.frustumPlanes));
+        numVisibleMeshes = numTransparentInstances;
+        meshletStats     = {};
+        meshletsOpaque.drawCommands_.clear();
+        meshletsOpaque.numCommands32_ = 0;
+        for (size_t i = 0; i != meshesOpaque.drawCommands_.size(); i++) {
+          const DrawIndexedIndirectCommand& c = meshesOpaque.drawCommands_[i];
+          for (uint32_t k = 0; k != mesh.getResidentInstanceCount(c); k++) {
+            const uint32_t ddIndex     = c.baseInstance + k;
+            const uint32_t transformId = mesh.drawData_[ddIndex].transformId;
+            // reject whole meshes first, then split the visible ones into meshlets
+            if (!isNodeVisible(transformId))
+              continue;
+            const Mesh& m = meshView.meshes[scene.meshForNode[transformId]];
+            if (cullMeshlets(
+                    clusterView, m, meshView.meshlets, scene.globalTransform[transformId], ddIndex, meshletsOpaque.drawCommands_,
+                    &meshletStats))
+              numVisibleMeshes++;
+          }
+          // the meshlets inherit the index format of their mesh, so the 32-bit commands stay in front
+          if (i < meshesOpaque.numCommands32_)
+            meshletsOpaque.numCommands32_ = static_cast<uint32_t>(meshletsOpaque.drawCommands_.size());
+        }
+        if (!meshletsOpaque.drawCommands_.empty())
+          meshletsOpaque.uploadIndirectBuffer();
       }
 
-      // 0. Update shadow map
-      if (prevLight != light) {
+      // 0. Update shadow map (the streamed geometry and the moved nodes cast new shadows)
+      if (prevLight != light || geometryStreamed || !movedNodes.empty()) {
         prevLight = light;
         buf.cmdBeginRendering(
             lvk::RenderPass{
@@ -662,7 +1012,7 @@ int main()
               .color = { { .loadOp = lvk::LoadOp_Clear, .storeOp = lvk::StoreOp_MsaaResolve, .clearColor = { 1.0f, 1.0f, 1.0f, 1.0f } } },
               .depth = { .loadOp = lvk::LoadOp_Clear, .storeOp = lvk::StoreOp_MsaaResolve, .clearDepth = 1.0f }
       },
-          framebufferMSAA, { .buffers = { lvk::BufferHandle(meshesOpaque.bufferIndirect_) } });
+          framebufferMSAA, { .buffers = { lvk::BufferHandle(meshesOpaque.bufferIndirect_), lvk::BufferHandle(bufferVisibleDrawData) } });
       skyBox.draw(buf, view, proj);
       const struct {
         mat4 viewProj;
@@ -678,7 +1028,10 @@ int main()
         .viewProj            = proj * view,
         .cameraPos           = vec4(app.camera_.getPosition(), 1.0f),
         .bufferTransforms    = ctx->gpuAddress(mesh.bufferTransforms_),
-        .bufferDrawData      = ctx->gpuAddress(mesh.bufferDrawData_),
+        // the meshlet commands address the uncompacted DrawData, one instance each
+        .bufferDrawData      = ctx->gpuAddress(
+            cullingMode == CullingMode_CPU || cullingMode == CullingMode_GPU ? lvk::BufferHandle(bufferVisibleDrawData)
+                                                                                  : lvk::BufferHandle(mesh.bufferDrawData_)),
         .bufferMaterials     = ctx->gpuAddress(mesh.bufferMaterials_),
         .bufferOIT           = ctx->gpuAddress(bufferOIT),
         .bufferLight         = ctx->gpuAddress(bufferLight),
@@ -689,7 +1042,7 @@ int main()
         buf.cmdPushDebugGroupLabel("Mesh opaque", 0xff0000ff);
         mesh.draw(
             buf, pipelineOpaque, &pc, sizeof(pc), { .compareOp = lvk::CompareOp_Less, .isDepthWriteEnabled = true }, drawWireframe,
-            &meshesOpaque);
+            cullingMode == CullingMode_Meshlets ? &meshletsOpaque : &meshesOpaque);
         buf.cmdPopDebugGroupLabel();
       }
       if (drawMeshesTransparent) {
@@ -710,18 +1063,23 @@ int main()
       if (drawBoxes) {
 		  // draw transparent boxes (always visible)
         for (auto& c : meshesTransparent.drawCommands_) {
-          const uint32_t transformId = mesh.drawData_[c.baseInstance].transformId;
-          const uint32_t meshId      = scene.meshForNode[transformId];
-          const BoundingBox box      = meshData.boxes[meshId];
-          canvas3d.box(scene.globalTransform[transformId], box, vec4(0, 1, 0, 1));
+          for (uint32_t k = 0; k != c.instanceCount; k++) {
+            const uint32_t transformId = mesh.drawData_[c.baseInstance + k].transformId;
+            const uint32_t meshId      = scene.meshForNode[transformId];
+            const BoundingBox box      = meshView.boxes[meshId];
+            canvas3d.box(scene.globalTransform[transformId], box, vec4(0, 1, 0, 1));
+          }
         }
         // draw opaque boxes
         const DrawIndexedIndirectCommand* cmd = meshesOpaque.getDrawIndexedIndirectCommandPtr();
         for (auto& c : meshesOpaque.drawCommands_) {
-          const uint32_t transformId = mesh.drawData_[c.baseInstance].transformId;
-          const uint32_t meshId      = scene.meshForNode[transformId];
-          const BoundingBox box      = meshData.boxes[meshId];
-          canvas3d.box(scene.globalTransform[transformId], box, (cmd++)->instanceCount ? vec4(0, 1, 0, 1) : vec4(1, 0, 0, 1));
+          const vec4 color = (cmd++)->instanceCount ? vec4(0, 1, 0, 1) : vec4(1, 0, 0, 1);
+          for (uint32_t k = 0; k != c.instanceCount; k++) {
+            const uint32_t transformId = mesh.drawData_[c.baseInstance + k].transformId;
+            const uint32_t meshId      = scene.meshForNode[transformId];
+            const BoundingBox box      = meshView.boxes[meshId];
+            canvas3d.box(scene.globalTransform[transformId], box, color);
+          }
         }
       }
       canvas3d.render(*ctx.get(), framebufferMSAA, buf, kNumSamples);
@@ -954,10 +1312,37 @@ int main()
           ImGui::RadioButton("None (N)", &cullingMode, CullingMode_None);
           ImGui::RadioButton("CPU  (C)", &cullingMode, CullingMode_CPU);
           ImGui::RadioButton("GPU  (G)", &cullingMode, CullingMode_GPU);
+          ImGui::RadioButton("CPU meshlets (M)", &cullingMode, CullingMode_Meshlets);
           ImGui::Unindent(indentSize);
           ImGui::Checkbox("Freeze culling frustum (P)", &freezeCullingView);
+          ImGui::Checkbox("Meshlet backface cones", &cullBackfaceMeshlets);
+          ImGui::Checkbox("Dynamic LOD (meshlets use LOD0)", &enableDynamicLOD);
+          ImGui::SliderFloat("LOD max error, pixels", &lodMaxPixelError, 0.1f, 16.0f);
           ImGui::Separator();
           ImGui::Text("Visible meshes: %i", numVisibleMeshes);
+          if (!mesh.isGeometryResident())
+            ImGui::Text("Streaming meshes: %u / %u", mesh.getNumResidentMeshes(), mesh.numMeshes_);
+          if (cullingMode == CullingMode_Meshlets) {
+            ImGui::Text("Visible meshlets: %u / %u", meshletStats.numVisible, numOpaqueMeshlets);
+            ImGui::Text("Backface culled meshlets: %u", meshletStats.numBackfaceCulled);
+          }
+          ImGui::Separator();
+        }
+        if (ImGui::CollapsingHeader("Dynamic Nodes")) {
+          ImGui::Indent(indentSize);
+          ImGui::Checkbox("Animate dynamic nodes", &animateDynamicNodes);
+          ImGui::Checkbox("GPU global transforms", &gpuGlobalTransforms);
+          ImGui::Unindent(indentSize);
+          ImGui::Text("Dynamic nodes: %u", static_cast<uint32_t>(dynamicNodes.size()));
+          ImGui::Text("Moved nodes: %u", static_cast<uint32_t>(movedNodes.size()));
+          ImGui::Text("Spatial hash cells: %u", static_cast<uint32_t>(dynamicHash.cells.size()));
+          ImGui::SliderFloat("Neighbour radius", &dynamicNeighbourRadius, 0.5f, 50.0f);
+          const vec3 cameraPos = app.camera_.getPosition();
+          nearbyDynamicNodes.clear();
+          spatialHashQuery(
+              dynamicHash, BoundingBox(cameraPos - vec3(dynamicNeighbourRadius), cameraPos + vec3(dynamicNeighbourRadius)),
+              nearbyDynamicNodes);
+          ImGui::Text("Dynamic nodes around the camera: %u", static_cast<uint32_t>(nearbyDynamicNodes.size()));
           ImGui::Separator();
         }
         if (ImGui::CollapsingHeader("Order-Independent Transparency")) {
@@ -4,7 +4,6 @@
 #include <../../src/shaders/util/AlphaTest.sp>
 #include <../../src/shaders/util/UtilsPBR.sp>
 
-layout (location=0) in vec2 uv;
 layout (location=1) in flat uint materialId;
 
 void main() {
@@ -12,11 +12,12 @@ layout (location=2) out vec3 worldPos;
 layout (location=3) out flat uint materialId;
 
 void main() {
-  mat4 model = pc.transforms.model[pc.drawData.dd[gl_BaseInstance].transformId];
-  gl_Position = pc.viewProj * model * vec4(in_pos, 1.0);
+  mat4 model = pc.transforms.model[pc.drawData.dd[gl_InstanceIndex].transformId];
+  vec3 pos = dequantizePosition(pc.drawData.dd[gl_InstanceIndex], in_pos);
+  gl_Position = pc.viewProj * model * vec4(pos, 1.0);
   uv = vec2(in_tc.x, 1.0-in_tc.y);
   normal = transpose( inverse(mat3(model)) ) * in_normal;
-  vec4 posClip = model * vec4(in_pos, 1.0);
+  vec4 posClip = model * vec4(pos, 1.0);
   worldPos = posClip.xyz/posClip.w;
-  materialId = pc.drawData.dd[gl_BaseInstance].materialId;
+  materialId = pc.drawData.dd[gl_InstanceIndex].materialId;
 }
\ No newline at end of file
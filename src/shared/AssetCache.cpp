@@ -0,0 +1,239 @@
+#include "shared/AssetCache.h"
+#include "shared/Utils.h"
+
+#include <filesystem>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+// Manifest layout, one record per line, the paths go last and may contain spaces:
+//   file <size> <mtime> <hash> <path>
+//   artifact <params> <numSources> <path>
+//   source <hash> <path>                    (numSources lines following every artifact)
+static const char *kManifestHeader = "asset-cache-manifest 1";
+
+uint64_t hashFile(const char *fileName)
+{
+	FILE *f = fopen(fileName, "rb");
+
+	if (!f)
+		return 0;
+
+	SCOPE_EXIT
+	{
+		fclose(f);
+	};
+
+	std::vector<uint8_t> buffer(1024 * 1024);
+
+	uint64_t hash = 0xcbf29ce484222325ull; // the default seed of hashBytes()
+
+	while (const size_t bytesRead = fread(buffer.data(), 1, buffer.size(), f))
+		hash = hashBytes(buffer.data(), bytesRead, hash);
+
+	return hash;
+}
+
+static bool readLine(FILE *f, std::string &line)
+{
+	line.clear();
+
+	int c = 0;
+
+	while ((c = fgetc(f)) != EOF && c != '\n')
+		line.push_back((char)c);
+
+	return c != EOF || !line.empty();
+}
+
+bool loadAssetCacheManifest(const char *fileName, AssetCacheManifest &m)
+{
+	FILE *f = fopen(fileName, "rb");
+
+	if (!f)
+		return false;
+
+	SCOPE_EXIT
+	{
+		fclose(f);
+	};
+
+	std::string line;
+
+	if (!readLine(f, line) || line != kManifestHeader)
+	{
+		printf("Ignoring the asset cache manifest %s: unknown format\n", fileName);
+		return false;
+	}
+
+	AssetCacheEntry *entry = nullptr;
+
+	while (readLine(f, line))
+	{
+		int pathStart = 0;
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		uint64_t hash = 0;
+		uint32_t numSources = 0;
+
+		if (sscanf(line.c_str(), "file %" SCNu64 " %" SCNd64 " %" SCNx64 " %n", &size, &mtime, &hash, &pathStart) == 3 && pathStart)
+		{
+			m.files[line.substr(pathStart)] = {.size = size, .mtime = mtime, .hash = hash};
+		}
+		else if (sscanf(line.c_str(), "artifact %" SCNx64 " %u %n", &hash, &numSources, &pathStart) == 2 && pathStart)
+		{
+			entry = &m.artifacts[line.substr(pathStart)];
+			entry->params = hash;
+			entry->sources.clear();
+			entry->sources.reserve(numSources);
+		}
+		else if (sscanf(line.c_str(), "source %" SCNx64 " %n", &hash, &pathStart) == 1 && pathStart && entry)
+		{
+			entry->sources.push_back({.file = line.substr(pathStart), .hash = hash});
+		}
+	}
+
+	return true;
+}
+
+void saveAssetCacheManifest(const char *fileName, AssetCacheManifest &m)
+{
+	std::lock_guard lock(m.mutex);
+
+	const std::filesystem::path dir = std::filesystem::path(fileName).parent_path();
+
+	if (!dir.empty())
+		std::filesystem::create_directories(dir);
+
+	FILE *f = fopen(fileName, "wb");
+
+	if (!f)
+	{
+		printf("Cannot write the asset cache manifest %s\n", fileName);
+		return;
+	}
+
+	fprintf(f, "%s\n", kManifestHeader);
+
+	for (const auto &i : m.files)
+		fprintf(f, "file %" PRIu64 " %" PRId64 " %" PRIx64 " %s\n", i.second.size, i.second.mtime, i.second.hash, i.first.c_str());
+
+	for (const auto &i : m.artifacts)
+	{
+		fprintf(f, "artifact %" PRIx64 " %u %s\n", i.second.params, (uint32_t)i.second.sources.size(), i.first.c_str());
+		for (const AssetCacheSource &s : i.second.sources)
+			fprintf(f, "source %" PRIx64 " %s\n", s.hash, s.file.c_str());
+	}
+
+	fclose(f);
+}
+
+uint64_t getSourceHash(AssetCacheManifest &m, const std::string &file)
+{
+	std::error_code ec;
+
+	const uint64_t size = std::filesystem::file_size(file, ec);
+
+	if (ec)
+		return 0;
+
+	const int64_t mtime = (int64_t)std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+
+	if (ec)
+		return 0;
+
+	{
+		std::lock_guard lock(m.mutex);
+
+		const auto i = m.files.find(file);
+
+		if (i != m.files.end() && i->second.size == size && i->second.mtime == mtime)
+			return i->second.hash;
+	}
+
+	// hash outside of the lock, large files take a while
+	const uint64_t hash = hashFile(file.c_str());
+
+	std::lock_guard lock(m.mutex);
+
+	m.files[file] = {.size = size, .mtime = mtime, .hash = hash};
+
+	return hash;
+}
+
+bool isAssetUpToDate(AssetCacheManifest &m, const std::string &artifact, uint64_t params, const std::vector<std::string> &sources)
+{
+	if (!std::filesystem::exists(artifact))
+		return false;
+
+	AssetCacheEntry entry;
+
+	{
+		std::lock_guard lock(m.mutex);
+
+		const auto i = m.artifacts.find(artifact);
+
+		if (i == m.artifacts.end())
+			return false;
+
+		entry = i->second;
+	}
+
+	if (entry.params != params || entry.sources.size() != sources.size())
+		return false;
+
+	for (size_t i = 0; i != sources.size(); i++)
+	{
+		if (entry.sources[i].file != sources[i] || entry.sources[i].hash != getSourceHash(m, sources[i]))
+			return false;
+	}
+
+	return true;
+}
+
+bool isAssetUpToDate(AssetCacheManifest &m, const std::string &artifact, uint64_t params)
+{
+	return isAssetUpToDate(m, artifact, params, getAssetSources(m, artifact));
+}
+
+void updateAsset(AssetCacheManifest &m, const std::string &artifact, uint64_t params, const std::vector<std::string> &sources)
+{
+	AssetCacheEntry entry = {.params = params};
+
+	entry.sources.reserve(sources.size());
+
+	for (const std::string &s : sources)
+		entry.sources.push_back({.file = s, .hash = getSourceHash(m, s)});
+
+	std::lock_guard lock(m.mutex);
+
+	m.artifacts[artifact] = std::move(entry);
+}
+
+std::vector<std::string> getCachedAssets(AssetCacheManifest &m, const std::string &prefix)
+{
+	std::lock_guard lock(m.mutex);
+
+	std::vector<std::string> result;
+
+	for (const auto &i : m.artifacts)
+		if (i.first.starts_with(prefix))
+			result.push_back(i.first);
+
+	return result;
+}
+
+std::vector<std::string> getAssetSources(AssetCacheManifest &m, const std::string &artifact)
+{
+	std::lock_guard lock(m.mutex);
+
+	std::vector<std::string> result;
+
+	const auto i = m.artifacts.find(artifact);
+
+	if (i != m.artifacts.end())
+		for (const AssetCacheSource &s : i->second.sources)
+			result.push_back(s.file);
+
+	return result;
+}
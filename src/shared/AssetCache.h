@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Incremental asset cache. Every cached artifact (a converted texture, a converted .obj file, the final merged scene) is keyed on
+   the content hashes of its source files and a hash of its conversion parameters. The keys live in a text manifest, so only the
+   stale artifacts have to be rebuilt. Content hashes are memoized by file size and modification time, so checking an up-to-date
+   cache costs one stat() per source file.
+ */
+struct AssetCacheSource
+{
+	std::string file;
+	uint64_t hash = 0;
+};
+
+struct AssetCacheEntry
+{
+	uint64_t params = 0;
+	std::vector<AssetCacheSource> sources;
+};
+
+struct AssetCacheManifest
+{
+	struct FileHash
+	{
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		uint64_t hash = 0;
+	};
+	std::unordered_map<std::string, FileHash> files;
+	std::unordered_map<std::string, AssetCacheEntry> artifacts;
+	// textures are converted in parallel
+	std::mutex mutex;
+};
+
+// hashBytes() of the whole file, 0 if the file cannot be read
+uint64_t hashFile(const char *fileName);
+
+// returns false if there is no manifest yet, `m` is empty then
+bool loadAssetCacheManifest(const char *fileName, AssetCacheManifest &m);
+void saveAssetCacheManifest(const char *fileName, AssetCacheManifest &m);
+
+// content hash of a source file, rehashed only if its size or modification time changed
+uint64_t getSourceHash(AssetCacheManifest &m, const std::string &file);
+
+// true if the artifact exists and was built with the same parameters from the same versions of the same sources
+bool isAssetUpToDate(AssetCacheManifest &m, const std::string &artifact, uint64_t params, const std::vector<std::string> &sources);
+// same as above, with the sources recorded in the manifest
+bool isAssetUpToDate(AssetCacheManifest &m, const std::string &artifact, uint64_t params);
+
+// record the current versions of the sources after the artifact has been rebuilt
+void updateAsset(AssetCacheManifest &m, const std::string &artifact, uint64_t params, const std::vector<std::string> &sources);
+
+// artifacts whose path starts with prefix, e.g. all textures in a cache folder
+std::vector<std::string> getCachedAssets(AssetCacheManifest &m, const std::string &prefix);
+std::vector<std::string> getAssetSources(AssetCacheManifest &m, const std::string &artifact);
@@ -0,0 +1,108 @@
+#include "shared/Scene/ClusterCulling.h"
+
+#include <algorithm>
+
+bool isConeBackfacing(const vec3 &coneApex, const vec3 &coneAxis, float coneCutoff, const vec3 &cameraPos)
+{
+	const vec3 dir = coneApex - cameraPos;
+	const float len = glm::length(dir);
+
+	// the camera is at the apex, nothing can be said
+	if (len <= 0.0f)
+		return false;
+
+	return glm::dot(dir / len, coneAxis) >= coneCutoff;
+}
+
+uint32_t cullMeshlets(
+	const ClusterCullingView &view, const Mesh &mesh, std::span<const Meshlet> meshlets, const mat4 &model, uint32_t baseInstance,
+	std::vector<DrawIndexedIndirectCommand> &out, ClusterCullingStats *stats)
+{
+	const size_t numCommands = out.size();
+
+	const vec3 scale(glm::length(vec3(model[0])), glm::length(vec3(model[1])), glm::length(vec3(model[2])));
+	const float maxScale = std::max(std::max(scale.x, scale.y), scale.z);
+	const float minScale = std::min(std::min(scale.x, scale.y), scale.z);
+
+	// normal cones survive only rotations, translations and uniform scaling
+	const bool testCones = view.enableBackfaceCulling && maxScale - minScale <= 0.001f * maxScale;
+
+	uint32_t numFrustumCulled = 0;
+	uint32_t numBackfaceCulled = 0;
+
+	for (uint32_t i = 0; i != mesh.meshletCount; i++)
+	{
+		const Meshlet &m = meshlets[mesh.meshletOffset + i];
+
+		const vec3 center = vec3(model * vec4(m.center[0], m.center[1], m.center[2], 1.0f));
+
+		if (!isSphereInFrustum(view.frustumPlanes, center, m.radius * maxScale))
+		{
+			numFrustumCulled++;
+			continue;
+		}
+
+		if (testCones)
+		{
+			const vec3 apex = vec3(model * vec4(m.coneApex[0], m.coneApex[1], m.coneApex[2], 1.0f));
+			const vec3 axis = glm::normalize(glm::mat3(model) * vec3(m.coneAxis[0], m.coneAxis[1], m.coneAxis[2]));
+
+			if (isConeBackfacing(apex, axis, m.coneCutoff, view.cameraPos))
+			{
+				numBackfaceCulled++;
+				continue;
+			}
+		}
+
+		out.push_back({
+			.count = m.indexCount,
+			.instanceCount = 1,
+			.firstIndex = mesh.indexOffset + m.indexOffset,
+			.baseVertex = (int32_t)mesh.vertexOffset,
+			.baseInstance = baseInstance,
+		});
+	}
+
+	const uint32_t numVisible = (uint32_t)(out.size() - numCommands);
+
+	if (stats)
+	{
+		stats->numMeshlets += mesh.meshletCount;
+		stats->numFrustumCulled += numFrustumCulled;
+		stats->numBackfaceCulled += numBackfaceCulled;
+		stats->numVisible += numVisible;
+	}
+
+	return numVisible;
+}
+
+float getLODProjectionScale(const mat4 &proj, float viewportHeight)
+{
+	// proj[1][1] = 1 / tan(fovY / 2)
+	return 0.5f * viewportHeight * proj[1][1];
+}
+
+uint32_t selectLOD(
+	const Mesh &mesh, const BoundingSphere &sphere, const mat4 &model, const vec3 &cameraPos, float projScale, float maxPixelError)
+{
+	const BoundingSphere s = sphere.getTransformed(model);
+
+	// the errors are in mesh space
+	const float maxScale = std::max(std::max(glm::length(vec3(model[0])), glm::length(vec3(model[1]))), glm::length(vec3(model[2])));
+
+	// a camera inside the sphere always gets the finest LOD
+	const float distance = glm::length(s.center - cameraPos) - s.radius;
+
+	if (distance <= 0.0f)
+		return 0;
+
+	const float pixelsPerUnit = maxScale * projScale / distance;
+
+	uint32_t lod = 0;
+
+	// the errors grow with every LOD
+	while (lod + 1 < mesh.lodCount && mesh.lodError[lod + 1] * pixelsPerUnit <= maxPixelError)
+		lod++;
+
+	return lod;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <span>
+#include <vector>
+
+#include "shared/Scene/VtxData.h"
+#include "shared/UtilsMath.h"
+
+/* CPU cluster culling. Every meshlet of a mesh instance is tested against the frustum (bounding sphere) and, optionally,
+   against the camera position (normal cone). One indirect draw command is emitted per surviving meshlet, so a huge merged
+   mesh costs only its visible clusters. No GPU context is involved and all inputs are plain structures.
+   The LOD of a mesh instance is selected from the projected simplification error stored in Mesh::lodError.
+ */
+struct ClusterCullingView
+{
+	// world space planes from getFrustumPlanes(), they do not have to be normalized
+	vec4 frustumPlanes[6];
+	vec3 cameraPos = vec3(0.0f);
+	// the normal cone test is valid only for single-sided geometry
+	bool enableBackfaceCulling = false;
+};
+
+struct ClusterCullingStats
+{
+	uint32_t numMeshlets = 0;
+	uint32_t numFrustumCulled = 0;
+	uint32_t numBackfaceCulled = 0;
+	uint32_t numVisible = 0;
+};
+
+// true if all triangles bounded by the normal cone face away from the camera
+bool isConeBackfacing(const vec3 &coneApex, const vec3 &coneAxis, float coneCutoff, const vec3 &cameraPos);
+
+// Append one command per visible meshlet of the mesh instance. The commands use the same baseInstance (i.e. DrawData) as the
+// mesh would. meshlets is the whole MeshData::meshlets array. Returns the number of appended commands
+uint32_t cullMeshlets(
+	const ClusterCullingView &view, const Mesh &mesh, std::span<const Meshlet> meshlets, const mat4 &model, uint32_t baseInstance,
+	std::vector<DrawIndexedIndirectCommand> &out, ClusterCullingStats *stats = nullptr);
+
+// Converts a world-space size at unit distance into pixels: viewportHeight / (2 * tan(fovY / 2))
+float getLODProjectionScale(const mat4 &proj, float viewportHeight);
+
+// The coarsest LOD of the mesh instance whose error, projected from the closest point of the mesh-space bounding sphere,
+// does not exceed maxPixelError
+uint32_t selectLOD(
+	const Mesh &mesh, const BoundingSphere &sphere, const mat4 &model, const vec3 &cameraPos, float projScale, float maxPixelError);
@@ -1,46 +1,86 @@
 #include "shared/Scene/MergeUtil.h"
 #include "shared/Scene/Scene.h"
 
+#include <map>
+#include <tuple>
 #include <unordered_map>
 
-static uint32_t shiftMeshIndices(MeshData &meshData, const std::vector<uint32_t> &meshesToMerge)
+// offsets of the 2_10_10_10 attributes (normals) in a vertex, appendTransformedVertices() transforms them
+static std::vector<uint32_t> getNormalOffsets(const MeshData &md)
 {
-	uint32_t minVtxOffset = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> normalOffsets;
 
-	for (uint32_t i : meshesToMerge)
-		minVtxOffset = std::min(meshData.meshes[i].vertexOffset, minVtxOffset);
+	for (uint32_t i = 0; i != md.streams.getNumAttributes(); i++)
+		if (md.streams.attributes[i].format == lvk::VertexFormat::Int_2_10_10_10_REV)
+			normalOffsets.push_back((uint32_t)md.streams.attributes[i].offset);
 
-	uint32_t mergeCount = 0u; // calculated by summing index counts in meshesToMerge
+	return normalOffsets;
+}
+
+// Append the vertices of a mesh transformed by `t`. Normals (2_10_10_10 attributes) are transformed by the inverse transpose
+static void appendTransformedVertices(
+	const MeshData &md, const Mesh &mesh, const mat4 &t, const std::vector<uint32_t> &normalOffsets, std::vector<uint8_t> &dst)
+{
+	const uint32_t vertexSize = md.streams.getVertexSize();
+	const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(t)));
+
+	const size_t start = dst.size();
+	const uint8_t *src = md.vertexData.data() + (size_t)mesh.vertexOffset * vertexSize;
 
-	// now shift all the indices in individual index blocks [use minVtxOffset]
-	for (uint32_t i : meshesToMerge)
+	dst.insert(dst.end(), src, src + (size_t)mesh.vertexCount * vertexSize);
+
+	for (uint32_t i = 0; i != mesh.vertexCount; i++)
 	{
-		Mesh &m = meshData.meshes[i];
-		// for how much should we shift the indices in mesh [m]
-		const uint32_t delta = m.vertexOffset - minVtxOffset;
-		const uint32_t idxCount = m.getLODIndicesCount(0);
-		for (uint32_t ii = 0u; ii < idxCount; ii++)
-			meshData.indexData[m.indexOffset + ii] += delta;
+		uint8_t *v = dst.data() + start + (size_t)i * vertexSize;
 
-		m.vertexOffset = minVtxOffset;
+		vec3 p;
+		memcpy(&p, v, sizeof(vec3));
+		p = vec3(t * vec4(p, 1.0f));
+		memcpy(v, &p, sizeof(vec3));
 
-		// sum all the deleted meshes' indices
-		mergeCount += idxCount;
+		for (uint32_t offset : normalOffsets)
+		{
+			uint32_t packed = 0;
+			memcpy(&packed, v + offset, sizeof(packed));
+			const vec4 n = glm::unpackSnorm3x10_1x2(packed);
+			const vec3 tn = normalMatrix * vec3(n);
+			const float len = glm::length(tn);
+			packed = glm::packSnorm3x10_1x2(vec4(len > 0.0f ? tn / len : vec3(n), n.w));
+			memcpy(v + offset, &packed, sizeof(packed));
+		}
 	}
-
-	return meshData.indexData.size() - mergeCount;
 }
 
-// All the meshesToMerge now have the same vertexOffset and individual index values are shifted by appropriate amount
-// Here we move all the indices to appropriate places in the new index array
-static void mergeIndexArray(MeshData &md, const std::vector<uint32_t> &meshesToMerge, std::unordered_map<uint32_t, uint32_t> &oldToNew)
+// Rebuild both index arrays and the vertex array. The meshes that are kept are compacted at the beginning with all their LODs, and the
+// LOD0 indices of meshesToMerge are appended as a single mesh. Every merged node contributes one copy of its mesh's vertices with its
+// transform (mergedTransforms[i] for the mesh mergedMeshes[i]) baked in, so [vertexOffset, vertexOffset + vertexCount) of every kept
+// mesh covers exactly its own vertices. Meshlets are relative to Mesh::indexOffset, so they follow their indices.
+// The merged mesh goes through the same meshoptimizer passes as a freshly converted mesh: the vertices shared by the source meshes
+// are welded, the triangles are reordered across the former mesh boundaries and the LOD chain is rebuilt from the merged LOD0 (if the
+// source meshes had LODs). Its meshlets are dropped, run generateMeshlets() afterwards. It uses 16-bit indices only if they still fit
+static void mergeMeshArrays(
+	MeshData &md, const std::vector<uint32_t> &meshesToMerge, const std::vector<uint32_t> &mergedMeshes,
+	const std::vector<mat4> &mergedTransforms, std::vector<uint32_t> &oldToNew)
 {
-	std::vector<uint32_t> newIndices(md.indexData.size());
-	// Two offsets in the new indices array (one begins at the start, the second one after all the copied indices)
-	uint32_t copyOffset = 0;
-	uint32_t mergeOffset = shiftMeshIndices(md, meshesToMerge);
+	const uint32_t vertexSize = md.streams.getVertexSize();
+
+	std::vector<uint8_t> newVertices;
+	std::vector<uint8_t> mergedVertices;
+	std::vector<uint32_t> newIndices;
+	std::vector<uint16_t> newIndices16;
+	std::vector<uint32_t> mergedIndices;
+	std::vector<Meshlet> newMeshlets;
+	bool hasLODs = false;
+
+	newVertices.reserve(md.vertexData.size());
+	newIndices.reserve(md.indexData.size());
+	newIndices16.reserve(md.indexData16.size());
+
+	// the merged geometry is reoptimized with meshoptimizer
+	LVK_ASSERT(md.streams.attributes[0].format == lvk::VertexFormat::Float3);
 
 	const size_t mergedMeshIndex = md.meshes.size() - meshesToMerge.size();
+	oldToNew.resize(md.meshes.size());
 	uint32_t newIndex = 0u;
 	for (size_t midx = 0u; midx < md.meshes.size(); midx++)
 	{
@@ -50,27 +90,119 @@ static void mergeIndexArray(MeshData &md, const std::vector<uint32_t> &meshesToM
 		newIndex += shouldMerge ? 0 : 1;
 
 		Mesh &mesh = md.meshes[midx];
-		const uint32_t idxCount = mesh.getLODIndicesCount(0);
 
-		// move all indices to the new array at mergeOffset
-		const auto start = md.indexData.begin() + mesh.indexOffset;
-		mesh.indexOffset = copyOffset;
-		uint32_t *const offsetPtr = shouldMerge ? &mergeOffset : &copyOffset;
-		std::copy(start, start + idxCount, newIndices.begin() + *offsetPtr);
-		*offsetPtr += idxCount;
+		const auto firstVertex = md.vertexData.begin() + (size_t)mesh.vertexOffset * vertexSize;
+		const auto lastVertex = firstVertex + (size_t)mesh.vertexCount * vertexSize;
+
+		if (shouldMerge)
+		{
+			hasLODs = hasLODs || mesh.lodCount > 1;
+			continue;
+		}
+
+		mesh.vertexOffset = (uint32_t)(newVertices.size() / vertexSize);
+		newVertices.insert(newVertices.end(), firstVertex, lastVertex);
+
+		// LOD offsets are relative to indexOffset, so all of them are copied as one block
+		const uint32_t idxCount = mesh.lodOffset[mesh.lodCount];
+
+		const auto firstMeshlet = md.meshlets.begin() + mesh.meshletOffset;
+		mesh.meshletOffset = (uint32_t)newMeshlets.size();
+		newMeshlets.insert(newMeshlets.end(), firstMeshlet, firstMeshlet + mesh.meshletCount);
+
+		if (mesh.isIndex16())
+		{
+			const auto start = md.indexData16.begin() + mesh.indexOffset;
+			mesh.indexOffset = (uint32_t)newIndices16.size();
+			newIndices16.insert(newIndices16.end(), start, start + idxCount);
+		}
+		else
+		{
+			const auto start = md.indexData.begin() + mesh.indexOffset;
+			mesh.indexOffset = (uint32_t)newIndices.size();
+			newIndices.insert(newIndices.end(), start, start + idxCount);
+		}
 	}
 
-	md.indexData = newIndices;
+	// the merged meshes still reference the old arrays
+	const std::vector<uint32_t> normalOffsets = getNormalOffsets(md);
+
+	for (size_t i = 0; i != mergedMeshes.size(); i++)
+	{
+		const Mesh &mesh = md.meshes[mergedMeshes[i]];
+
+		// for how much should we shift the indices of this copy
+		const uint32_t delta = (uint32_t)(mergedVertices.size() / vertexSize);
+		appendTransformedVertices(md, mesh, mergedTransforms[i], normalOffsets, mergedVertices);
+		const uint32_t idxCount = mesh.getLODIndicesCount(0);
+		for (uint32_t ii = 0u; ii < idxCount; ii++)
+			mergedIndices.push_back(getMeshIndex(md, mesh, mesh.lodOffset[0] + ii) + delta);
+	}
+
+	const uint32_t numVerticesBefore = (uint32_t)(mergedVertices.size() / vertexSize);
+
+	optimizeMeshGeometry(mergedIndices, mergedVertices, vertexSize);
+
+	std::vector<std::vector<uint32_t>> lods;
+	std::vector<float> lodErrors;
+	processLODs(mergedIndices, mergedVertices, vertexSize, lods, lodErrors, hasLODs);
 
 	// all the merged indices are now in lastMesh
 	Mesh lastMesh = md.meshes[meshesToMerge[0]];
-	lastMesh.indexOffset = copyOffset;
-	lastMesh.lodOffset[0] = copyOffset;
-	lastMesh.lodOffset[1] = mergeOffset;
-	lastMesh.lodCount = 1;
+	lastMesh.vertexOffset = (uint32_t)(newVertices.size() / vertexSize);
+	lastMesh.vertexCount = (uint32_t)(mergedVertices.size() / vertexSize);
+	newVertices.insert(newVertices.end(), mergedVertices.begin(), mergedVertices.end());
+	lastMesh.lodCount = (uint32_t)lods.size();
+	lastMesh.meshletOffset = (uint32_t)newMeshlets.size();
+	lastMesh.meshletCount = 0;
+
+	uint32_t numIndices = 0;
+	for (uint32_t l = 0; l != lastMesh.lodCount; l++)
+	{
+		lastMesh.lodOffset[l] = numIndices;
+		lastMesh.lodError[l] = lodErrors[l];
+		numIndices += (uint32_t)lods[l].size();
+	}
+	lastMesh.lodOffset[lastMesh.lodCount] = numIndices;
+
+	printf("Reoptimized merged mesh: %u -> %u vertices, %u LODs\n", numVerticesBefore, lastMesh.vertexCount, lastMesh.lodCount);
+
+	// the indices are local to the mesh and every vertex is referenced
+	const bool fitsIndex16 = lastMesh.vertexCount <= 65536;
+
+	if (fitsIndex16)
+	{
+		lastMesh.flags |= sMeshFlags_Index16;
+		lastMesh.indexOffset = (uint32_t)newIndices16.size();
+		for (const std::vector<uint32_t> &lod : lods)
+			newIndices16.insert(newIndices16.end(), lod.begin(), lod.end());
+	}
+	else
+	{
+		lastMesh.flags &= ~sMeshFlags_Index16;
+		lastMesh.indexOffset = (uint32_t)newIndices.size();
+		for (const std::vector<uint32_t> &lod : lods)
+			newIndices.insert(newIndices.end(), lod.begin(), lod.end());
+	}
+
+	md.indexData = std::move(newIndices);
+	md.indexData16 = std::move(newIndices16);
+	md.vertexData = std::move(newVertices);
+	md.meshlets = std::move(newMeshlets);
 	md.meshes.push_back(lastMesh);
 }
 
+// the global transform of a node from the local transforms of its parent chain
+static mat4 getGlobalTransform(const Scene &scene, int node)
+{
+	mat4 t = scene.localTransform[node];
+
+	for (int p = scene.hierarchy[node].parent; p != -1; p = scene.hierarchy[p].parent)
+		t = scene.localTransform[p] * t;
+
+	return t;
+}
+
 void mergeNodesWithMaterial(Scene &scene, MeshData &meshData, const std::string &materialName)
 {
 	// Find material index
@@ -79,47 +211,421 @@ void mergeNodesWithMaterial(Scene &scene, MeshData &meshData, const std::string
 
 	std::vector<uint32_t> toDelete;
 
-	for (size_t i = 0u; i < scene.hierarchy.size(); i++)
-		if (scene.meshForNode.contains(i) && scene.materialForNode.contains(i) && (scene.materialForNode.at(i) == oldMaterial))
+	// the reverse material index gives us a sorted list of nodes without scanning the entire hierarchy
+	for (uint32_t i : getNodesWithMaterial(scene, (uint32_t)oldMaterial))
+		if (scene.meshForNode.contains(i))
 			toDelete.push_back(i);
 
+	if (toDelete.empty())
+		return;
+
 	std::vector<uint32_t> meshesToMerge(toDelete.size());
 
 	// Convert toDelete indices to mesh indices
 	std::transform(toDelete.begin(), toDelete.end(), meshesToMerge.begin(), [&scene](uint32_t i)
 				   { return scene.meshForNode.at(i); });
 
-	// TODO: if merged mesh transforms are non-zero, then we should pre-transform individual mesh vertices in meshData using local transform
+	// mergeMeshArrays() and eraseSelected() rely on binary search
+	std::sort(meshesToMerge.begin(), meshesToMerge.end());
+	meshesToMerge.erase(std::unique(meshesToMerge.begin(), meshesToMerge.end()), meshesToMerge.end());
+
+	// the merged node is attached to the root, so the vertices of every node are baked relative to it. Only the merged nodes need
+	// their global transforms, the rest of the scene is not recalculated
+	const mat4 rootTransform = getGlobalTransform(scene, 0);
+	const mat4 invRoot = glm::inverse(rootTransform);
+
+	std::vector<uint32_t> mergedMeshes(toDelete.size());
+	std::vector<mat4> mergedTransforms(toDelete.size());
+
+	for (size_t i = 0; i != toDelete.size(); i++)
+	{
+		mergedMeshes[i] = scene.meshForNode.at(toDelete[i]);
+		mergedTransforms[i] = invRoot * getGlobalTransform(scene, (int)toDelete[i]);
+	}
 
 	// old-to-new mesh indices
-	std::unordered_map<uint32_t, uint32_t> oldToNew;
+	std::vector<uint32_t> oldToNew;
 
 	// now move all the meshesToMerge to the end of array
-	mergeIndexArray(meshData, meshesToMerge, oldToNew);
+	mergeMeshArrays(meshData, meshesToMerge, mergedMeshes, mergedTransforms, oldToNew);
 
 	// cutoff all but one of the merged meshes (insert the last saved mesh from meshesToMerge - they are all the same)
 	eraseSelected(meshData.meshes, meshesToMerge);
 
-	for (auto &n : scene.meshForNode)
-		n.second = oldToNew[n.second];
+	remapNodeMeshes(scene, oldToNew);
 
-	// reattach the node with merged meshes [identity transforms are assumed]
-	int newNode = addNode(scene, 0, 1);
-	scene.meshForNode[newNode] = (int)meshData.meshes.size() - 1;
-	scene.materialForNode[newNode] = (uint32_t)oldMaterial;
+	// reattach the node with merged meshes, its local transform is identity
+	const int newNode = addNode(scene, 0, 1, (int)meshData.meshes.size() - 1, oldMaterial);
+	scene.globalTransform[newNode] = rootTransform;
 
 	deleteSceneNodes(scene, toDelete);
+
+	// the boxes of the erased meshes are gone and the merged mesh has none yet
+	if (!meshData.boxes.empty())
+		recalculateBoundingBoxes(meshData);
+}
+
+// all LODs of a mesh are stored as one block of 16-bit or 32-bit indices starting at indexOffset
+static const void *getMeshIndices(const MeshData &md, const Mesh &mesh, size_t &sizeInBytes)
+{
+	const size_t numIndices = mesh.lodOffset[mesh.lodCount];
+
+	if (mesh.isIndex16())
+	{
+		sizeInBytes = numIndices * sizeof(uint16_t);
+		return md.indexData16.data() + mesh.indexOffset;
+	}
+
+	sizeInBytes = numIndices * sizeof(uint32_t);
+	return md.indexData.data() + mesh.indexOffset;
+}
+
+static bool isSameGeometry(const MeshData &md, const Mesh &a, const Mesh &b, uint32_t vertexSize)
+{
+	if (a.vertexCount != b.vertexCount || a.lodCount != b.lodCount || a.materialID != b.materialID || a.flags != b.flags ||
+		memcmp(a.lodOffset, b.lodOffset, sizeof(a.lodOffset)) != 0 || memcmp(a.posOffset, b.posOffset, sizeof(a.posOffset)) != 0 ||
+		memcmp(a.posScale, b.posScale, sizeof(a.posScale)) != 0)
+		return false;
+
+	size_t sizeA = 0;
+	size_t sizeB = 0;
+	const void *indicesA = getMeshIndices(md, a, sizeA);
+	const void *indicesB = getMeshIndices(md, b, sizeB);
+
+	// indices are relative to vertexOffset, so they can be compared directly
+	return memcmp(indicesA, indicesB, sizeA) == 0 &&
+		   memcmp(
+			   md.vertexData.data() + (size_t)a.vertexOffset * vertexSize, md.vertexData.data() + (size_t)b.vertexOffset * vertexSize,
+			   (size_t)a.vertexCount * vertexSize) == 0;
 }
 
-void mergeMaterialLists(
+// Compact the geometry of the remaining meshes, exactly like mergeMeshArrays() does for the kept meshes, and erase the meshes in the
+// sorted toDelete list. Bounding volumes are erased if present
+static void eraseMeshes(MeshData &md, const std::vector<uint32_t> &toDelete)
+{
+	const uint32_t vertexSize = md.streams.getVertexSize();
+	const uint32_t numMeshes = (uint32_t)md.meshes.size();
+
+	std::vector<uint8_t> newVertices;
+	std::vector<uint32_t> newIndices;
+	std::vector<uint16_t> newIndices16;
+	std::vector<Meshlet> newMeshlets;
+
+	newVertices.reserve(md.vertexData.size());
+	newIndices.reserve(md.indexData.size());
+	newIndices16.reserve(md.indexData16.size());
+	newMeshlets.reserve(md.meshlets.size());
+
+	for (uint32_t m = 0; m != numMeshes; m++)
+	{
+		if (std::binary_search(toDelete.begin(), toDelete.end(), m))
+			continue;
+
+		Mesh &mesh = md.meshes[m];
+
+		const auto firstVertex = md.vertexData.begin() + (size_t)mesh.vertexOffset * vertexSize;
+		mesh.vertexOffset = (uint32_t)(newVertices.size() / vertexSize);
+		newVertices.insert(newVertices.end(), firstVertex, firstVertex + (size_t)mesh.vertexCount * vertexSize);
+
+		const auto firstMeshlet = md.meshlets.begin() + mesh.meshletOffset;
+		mesh.meshletOffset = (uint32_t)newMeshlets.size();
+		newMeshlets.insert(newMeshlets.end(), firstMeshlet, firstMeshlet + mesh.meshletCount);
+
+		const uint32_t idxCount = mesh.lodOffset[mesh.lodCount];
+
+		if (mesh.isIndex16())
+		{
+			const auto start = md.indexData16.begin() + mesh.indexOffset;
+			mesh.indexOffset = (uint32_t)newIndices16.size();
+			newIndices16.insert(newIndices16.end(), start, start + idxCount);
+		}
+		else
+		{
+			const auto start = md.indexData.begin() + mesh.indexOffset;
+			mesh.indexOffset = (uint32_t)newIndices.size();
+			newIndices.insert(newIndices.end(), start, start + idxCount);
+		}
+	}
+
+	md.vertexData = std::move(newVertices);
+	md.indexData = std::move(newIndices);
+	md.indexData16 = std::move(newIndices16);
+	md.meshlets = std::move(newMeshlets);
+
+	eraseSelected(md.meshes, toDelete);
+
+	// the bounding volumes are per-mesh
+	if (md.boxes.size() == numMeshes)
+		eraseSelected(md.boxes, toDelete);
+	if (md.spheres.size() == numMeshes)
+		eraseSelected(md.spheres, toDelete);
+	if (md.obbs.size() == numMeshes)
+		eraseSelected(md.obbs, toDelete);
+}
+
+uint32_t deduplicateMeshes(Scene &scene, MeshData &md)
+{
+	const uint32_t vertexSize = md.streams.getVertexSize();
+	const uint32_t numMeshes = (uint32_t)md.meshes.size();
+
+	// content hash -> unique meshes with this hash (hash collisions are resolved by comparing the bytes)
+	std::unordered_map<uint64_t, std::vector<uint32_t>> uniqueMeshes;
+	std::vector<uint32_t> oldToNew(numMeshes);
+	std::vector<uint32_t> toDelete;
+
+	uint32_t newIndex = 0;
+
+	for (uint32_t m = 0; m != numMeshes; m++)
+	{
+		const Mesh &mesh = md.meshes[m];
+
+		size_t indicesSize = 0;
+		const void *indices = getMeshIndices(md, mesh, indicesSize);
+
+		uint64_t hash = hashBytes(md.vertexData.data() + (size_t)mesh.vertexOffset * vertexSize, (size_t)mesh.vertexCount * vertexSize);
+		hash = hashBytes(indices, indicesSize, hash);
+		hash = hashBytes(&mesh.materialID, sizeof(mesh.materialID), hash);
+
+		std::vector<uint32_t> &candidates = uniqueMeshes[hash];
+
+		const auto original = std::find_if(
+			candidates.begin(), candidates.end(), [&](uint32_t c) { return isSameGeometry(md, md.meshes[c], mesh, vertexSize); });
+
+		if (original != candidates.end())
+		{
+			oldToNew[m] = oldToNew[*original];
+			toDelete.push_back(m);
+			continue;
+		}
+
+		candidates.push_back(m);
+		oldToNew[m] = newIndex++;
+	}
+
+	if (toDelete.empty())
+		return 0;
+
+	eraseMeshes(md, toDelete);
+
+	remapNodeMeshes(scene, oldToNew);
+
+	printf("Deduplicated meshes: %u -> %u\n", numMeshes, (uint32_t)md.meshes.size());
+
+	return (uint32_t)toDelete.size();
+}
+
+// a node moves at runtime if it or any of its ancestors is dynamic
+static bool isNodeStatic(const Scene &scene, int node)
+{
+	for (; node != -1; node = scene.hierarchy[node].parent)
+		if (isNodeDynamic(scene, (uint32_t)node))
+			return false;
+
+	return true;
+}
+
+uint32_t batchStaticMeshes(Scene &scene, MeshData &md, float cellSize, uint32_t maxInstances)
+{
+	const lvk::VertexInput::VertexAttribute &pos = md.streams.attributes[0];
+
+	if (pos.offset != 0 || pos.format != lvk::VertexFormat::Float3)
+	{
+		printf("batchStaticMeshes(): Float3 positions expected, call it before quantizeMeshPositions()\n");
+		return 0;
+	}
+	if (!md.meshlets.empty())
+	{
+		printf("batchStaticMeshes(): call it before generateMeshlets()\n");
+		return 0;
+	}
+
+	const uint32_t vertexSize = md.streams.getVertexSize();
+	const uint32_t numMeshes = (uint32_t)md.meshes.size();
+
+	const std::vector<uint32_t> normalOffsets = getNormalOffsets(md);
+
+	markAsChanged(scene, 0);
+	recalculateGlobalTransforms(scene);
+
+	// the batches are attached to the root, so the vertices are baked relative to it
+	const mat4 invRoot = glm::inverse(scene.globalTransform[0]);
+
+	// (material, cell) -> nodes; std::map keeps the output deterministic
+	std::map<std::tuple<uint32_t, int, int, int>, std::vector<uint32_t>> batches;
+
+	for (const auto &n : scene.meshForNode)
+	{
+		const uint32_t node = n.first;
+		const Mesh &mesh = md.meshes[n.second];
+
+		// the dynamic nodes keep their own transforms, instanced meshes stay instanced (see deduplicateMeshes())
+		if (!mesh.vertexCount || !isNodeStatic(scene, (int)node) || getNodesWithMesh(scene, n.second).size() > maxInstances)
+			continue;
+
+		vec3 minV(std::numeric_limits<float>::max());
+		vec3 maxV(std::numeric_limits<float>::lowest());
+
+		for (uint32_t i = 0; i != mesh.vertexCount; i++)
+		{
+			vec3 p;
+			memcpy(&p, md.vertexData.data() + (size_t)(mesh.vertexOffset + i) * vertexSize, sizeof(vec3));
+			minV = glm::min(minV, p);
+			maxV = glm::max(maxV, p);
+		}
+
+		const vec3 center = vec3(scene.globalTransform[node] * vec4(0.5f * (minV + maxV), 1.0f));
+		const glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+
+		batches[{mesh.materialID, cell.x, cell.y, cell.z}].push_back(node);
+	}
+
+	std::vector<uint32_t> batchedNodes;
+	uint32_t numBatches = 0;
+
+	for (auto &b : batches)
+	{
+		std::vector<uint32_t> &nodes = b.second;
+
+		// a single node gains nothing from baking its transform
+		if (nodes.size() < 2)
+			continue;
+
+		std::sort(nodes.begin(), nodes.end());
+
+		Mesh batch = {
+			.lodCount = 0,
+			.vertexOffset = (uint32_t)(md.vertexData.size() / vertexSize),
+			.materialID = std::get<0>(b.first),
+		};
+
+		std::vector<mat4> transforms(nodes.size());
+		std::vector<uint32_t> baseVertices(nodes.size());
+		std::vector<uint8_t> vertices;
+
+		for (size_t i = 0; i != nodes.size(); i++)
+		{
+			const Mesh &mesh = md.meshes[scene.meshForNode.at(nodes[i])];
+			transforms[i] = invRoot * scene.globalTransform[nodes[i]];
+			baseVertices[i] = (uint32_t)(vertices.size() / vertexSize);
+			batch.lodCount = std::max(batch.lodCount, mesh.lodCount);
+			appendTransformedVertices(md, mesh, transforms[i], normalOffsets, vertices);
+		}
+
+		batch.vertexCount = (uint32_t)(vertices.size() / vertexSize);
+
+		// LOD l of the batch is LOD l of every member, or its coarsest LOD if it has fewer
+		std::vector<uint32_t> indices;
+
+		for (uint32_t l = 0; l != batch.lodCount; l++)
+		{
+			batch.lodOffset[l] = (uint32_t)indices.size();
+
+			for (size_t i = 0; i != nodes.size(); i++)
+			{
+				const Mesh &mesh = md.meshes[scene.meshForNode.at(nodes[i])];
+				const uint32_t lod = std::min(l, mesh.lodCount - 1);
+				const uint32_t first = (uint32_t)indices.size();
+
+				for (uint32_t j = 0; j != mesh.getLODIndicesCount(lod); j++)
+					indices.push_back(getMeshIndex(md, mesh, mesh.lodOffset[lod] + j) + baseVertices[i]);
+
+				// mirroring transforms flip the winding
+				if (glm::determinant(transforms[i]) < 0.0f)
+					for (uint32_t j = first; j + 2 < indices.size(); j += 3)
+						std::swap(indices[j + 1], indices[j + 2]);
+
+				// the error is in mesh space, scale it into the space of the batch
+				const glm::mat3 m = glm::mat3(transforms[i]);
+				const float scale = std::max({glm::length(m[0]), glm::length(m[1]), glm::length(m[2])});
+				batch.lodError[l] = std::max(batch.lodError[l], mesh.lodError[lod] * scale);
+			}
+		}
+		batch.lodOffset[batch.lodCount] = (uint32_t)indices.size();
+
+		if (batch.vertexCount <= 65536)
+		{
+			batch.flags |= sMeshFlags_Index16;
+			batch.indexOffset = (uint32_t)md.indexData16.size();
+			md.indexData16.insert(md.indexData16.end(), indices.begin(), indices.end());
+		}
+		else
+		{
+			batch.indexOffset = (uint32_t)md.indexData.size();
+			md.indexData.insert(md.indexData.end(), indices.begin(), indices.end());
+		}
+
+		md.vertexData.insert(md.vertexData.end(), vertices.begin(), vertices.end());
+		md.meshes.push_back(batch);
+
+		const int newNode = addNode(scene, 0, 1, (int)md.meshes.size() - 1, (int)batch.materialID);
+		scene.globalTransform[newNode] = scene.globalTransform[0];
+
+		mergeVectors(batchedNodes, nodes);
+		numBatches++;
+	}
+
+	if (batchedNodes.empty())
+		return 0;
+
+	std::sort(batchedNodes.begin(), batchedNodes.end());
+
+	std::vector<uint32_t> nodesToDelete;
+
+	for (uint32_t node : batchedNodes)
+	{
+		removeNodeMesh(scene, (int)node);
+		removeNodeMaterial(scene, (int)node);
+		// the mesh nodes of the imported scenes are leaves, anything else keeps its node and loses only the mesh
+		if (scene.hierarchy[node].firstChild == -1)
+			nodesToDelete.push_back(node);
+	}
+
+	// a mesh is still needed if some of its instances were not batched
+	std::vector<bool> isUsed(md.meshes.size(), false);
+
+	for (const auto &n : scene.meshForNode)
+		isUsed[n.second] = true;
+
+	std::vector<uint32_t> toDelete;
+	std::vector<uint32_t> oldToNew(md.meshes.size());
+
+	for (uint32_t m = 0, newIndex = 0; m != (uint32_t)md.meshes.size(); m++)
+	{
+		oldToNew[m] = newIndex;
+		if (isUsed[m] || m >= numMeshes)
+			newIndex++;
+		else
+			toDelete.push_back(m);
+	}
+
+	eraseMeshes(md, toDelete);
+
+	remapNodeMeshes(scene, oldToNew);
+
+	deleteSceneNodes(scene, nodesToDelete);
+
+	// the batches cover new areas, the boxes have to be regenerated
+	recalculateBoundingBoxes(md);
+
+	printf(
+		"Static batching: %u nodes -> %u batches, meshes: %u -> %u\n", (uint32_t)batchedNodes.size(), numBatches, numMeshes,
+		(uint32_t)md.meshes.size());
+
+	return numBatches;
+}
+
+std::vector<uint32_t> mergeMaterialLists(
 	const std::vector<std::vector<Material> *> &oldMaterials, const std::vector<std::vector<std::string> *> &oldTextures,
 	std::vector<Material> &allMaterials, std::vector<std::string> &newTextures)
 {
-	// map texture names to indices in newTexturesList (calculated as we fill the newTexturesList)
-	std::unordered_map<std::string, int> newTextureNames;
+	// texture IDs in newTextures (calculated as we fill the newTextures)
+	StringTable newTextureNames;
 	std::unordered_map<size_t, size_t> materialToTextureList; // use the index of Material in the allMaterials array
 
-	// create a combined material list [no hashing of materials, just straightforward merging of all lists]
+	for (const std::string &file : newTextures)
+		internPath(newTextureNames, file);
+
+	// create a combined material list, the duplicates are collapsed below once the texture indices are global
 	for (size_t midx = 0; midx != oldMaterials.size(); midx++)
 	{
 		for (const Material &m : *oldMaterials[midx])
@@ -134,7 +640,7 @@ void mergeMaterialLists(
 	{
 		for (const std::string &file : *tl)
 		{
-			newTextureNames[file] = addUnique(newTextures, file);
+			internPath(newTextureNames, file);
 		}
 	}
 
@@ -147,7 +653,7 @@ void mergeMaterialLists(
 		const size_t listIdx = materialToTextureList[mtlId];
 		const std::vector<std::string> &texList = *oldTextures[listIdx];
 		const std::string &texFile = texList[*textureID];
-		*textureID = newTextureNames[texFile];
+		*textureID = internPath(newTextureNames, texFile);
 	};
 
 	for (size_t i = 0; i < allMaterials.size(); i++)
@@ -158,4 +664,59 @@ void mergeMaterialLists(
 		replaceTexture(i, &m.normalTexture);
 		replaceTexture(i, &m.opacityTexture);
 	}
+
+	newTextures = std::move(newTextureNames.strings);
+
+	// Material has no padding, identical materials are byte-identical after the texture remapping
+	static_assert(sizeof(Material) == 2 * sizeof(vec4) + 4 * sizeof(float) + 4 * sizeof(int) + sizeof(uint32_t));
+
+	std::vector<uint32_t> materialRemap(allMaterials.size());
+	std::unordered_map<uint64_t, std::vector<uint32_t>> uniqueMaterials;
+
+	const uint32_t numMaterials = (uint32_t)allMaterials.size();
+
+	uint32_t numUnique = 0;
+
+	for (uint32_t i = 0; i != numMaterials; i++)
+	{
+		const Material &m = allMaterials[i];
+
+		std::vector<uint32_t> &candidates = uniqueMaterials[hashBytes(&m, sizeof(Material))];
+
+		const auto same = std::find_if(
+			candidates.begin(), candidates.end(), [&](uint32_t u) { return memcmp(&allMaterials[u], &m, sizeof(Material)) == 0; });
+
+		if (same != candidates.end())
+		{
+			materialRemap[i] = *same;
+			continue;
+		}
+
+		candidates.push_back(numUnique);
+		materialRemap[i] = numUnique;
+		allMaterials[numUnique++] = m;
+	}
+
+	allMaterials.resize(numUnique);
+
+	printf("Deduplicated materials: %u -> %u\n", numMaterials, numUnique);
+
+	return materialRemap;
+}
+
+void remapSceneMaterials(Scene &scene, const std::vector<uint32_t> &materialRemap)
+{
+	std::vector<std::string> materialNames;
+
+	for (uint32_t i = 0; i != (uint32_t)materialRemap.size(); i++)
+	{
+		// the first material of every group of duplicates keeps its name
+		if (materialRemap[i] == materialNames.size())
+			materialNames.push_back(i < scene.materialNames.size() ? scene.materialNames[i] : std::string());
+	}
+
+	if (scene.materialNames.size() == materialRemap.size())
+		scene.materialNames = std::move(materialNames);
+
+	remapNodeMaterials(scene, materialRemap);
 }
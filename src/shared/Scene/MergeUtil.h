@@ -5,8 +5,22 @@
 
 void mergeNodesWithMaterial(Scene &scene, MeshData &meshData, const std::string &materialName);
 
-// Merge material lists from multiple scenes (follows the logic of merging in mergeScenes)
-void mergeMaterialLists(
+// Collapse meshes with byte-identical vertices, indices (all LODs) and the same material into one Mesh record. The nodes referencing
+// the duplicates are reattached to the first copy, so VKMesh11 draws them with a single instanced command. Returns the number of
+// removed meshes. Bounding volumes and meshlets are compacted if present, but it is cheaper to call this before generating them
+uint32_t deduplicateMeshes(Scene &scene, MeshData &meshData);
+
+// Static batching: the static mesh nodes (neither they nor their ancestors are marked with sNodeFlags_Dynamic) are grouped by material
+// and by the cell of a cellSize grid (in world space) containing their center. Every group of two or more nodes becomes one mesh with
+// the global transforms baked into the vertices (relative to the root node), all LODs kept, attached to the root. Meshes drawn by more
+// than maxInstances nodes stay instanced. The batched nodes are deleted and the bounding boxes regenerated. Needs Float3 positions
+// and no meshlets yet. Returns the number of batches
+uint32_t batchStaticMeshes(Scene &scene, MeshData &meshData, float cellSize, uint32_t maxInstances = 1);
+
+// Merge material lists from multiple scenes (follows the logic of merging in mergeScenes). Materials identical after the texture
+// remapping are collapsed into one. Returns the remap from the index in the concatenated input lists to the index in allMaterials,
+// pass it to mergeMeshData() and remapSceneMaterials()
+std::vector<uint32_t> mergeMaterialLists(
 	// Input:
 	const std::vector<std::vector<Material> *> &oldMaterials,	// all materials
 	const std::vector<std::vector<std::string> *> &oldTextures, // all textures from all material lists
@@ -14,3 +28,6 @@ void mergeMaterialLists(
 	std::vector<Material> &allMaterials,
 	std::vector<std::string> &newTextures // all textures (merged from oldTextures, only unique items)
 );
+
+// Apply the remap returned by mergeMaterialLists() to the material component of a scene built by mergeScenes()
+void remapSceneMaterials(Scene &scene, const std::vector<uint32_t> &materialRemap);
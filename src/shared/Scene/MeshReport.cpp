@@ -0,0 +1,212 @@
+#include "shared/Scene/MeshReport.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <unordered_map>
+
+#include <meshoptimizer.h>
+
+#include <taskflow/taskflow.hpp>
+#include <taskflow/algorithm/for_each.hpp>
+
+static MeshLODReport analyzeLOD(const MeshData &md, const Mesh &mesh, uint32_t lod, uint32_t cacheSize, const std::vector<float> &positions)
+{
+	const uint32_t numIndices = mesh.getLODIndicesCount(lod);
+	const uint32_t vertexSize = md.streams.getVertexSize();
+
+	// the analyzers take mesh-local 32-bit indices
+	std::vector<uint32_t> indices(numIndices);
+	for (uint32_t i = 0; i != numIndices; i++)
+		indices[i] = getMeshIndex(md, mesh, mesh.lodOffset[lod] + i);
+
+	MeshLODReport r = {
+		.numTriangles = numIndices / 3,
+		.error = mesh.lodError[lod],
+	};
+
+	if (!numIndices)
+		return r;
+
+	const meshopt_VertexCacheStatistics vcs = meshopt_analyzeVertexCache(indices.data(), numIndices, mesh.vertexCount, cacheSize, 0, 0);
+	const meshopt_OverdrawStatistics os =
+		meshopt_analyzeOverdraw(indices.data(), numIndices, positions.data(), mesh.vertexCount, 3 * sizeof(float));
+	const meshopt_VertexFetchStatistics vfs = meshopt_analyzeVertexFetch(indices.data(), numIndices, mesh.vertexCount, vertexSize);
+
+	const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	r.acmr = vcs.acmr;
+	r.atvr = vcs.atvr;
+	r.overdraw = os.overdraw;
+	r.overfetch = vfs.overfetch;
+	r.bytesPerTriangle = (float)(numIndices * indexSize + (size_t)mesh.vertexCount * vertexSize) / (float)r.numTriangles;
+
+	return r;
+}
+
+std::vector<MeshReport> analyzeMeshes(const MeshData &md, uint32_t cacheSize)
+{
+	const uint32_t vertexSize = md.streams.getVertexSize();
+	const uint32_t numMeshes = (uint32_t)md.meshes.size();
+
+	std::vector<MeshReport> reports(numMeshes);
+
+	tf::Executor executor(getNumConversionThreads());
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, numMeshes, 1u, [&md, &reports, cacheSize, vertexSize](int i)
+							{
+		const Mesh &mesh = md.meshes[i];
+
+		// the overdraw analyzer needs float positions, quantized positions are decoded
+		std::vector<float> positions(mesh.vertexCount * 3);
+		for (uint32_t v = 0; v != mesh.vertexCount; v++)
+		{
+			const vec3 p = getVertexPosition(md, mesh, mesh.vertexOffset + v);
+			memcpy(&positions[v * 3], &p, sizeof(vec3));
+		}
+
+		MeshReport &r = reports[i];
+
+		r.mesh = (uint32_t)i;
+		r.materialID = mesh.materialID;
+		r.vertexCount = mesh.vertexCount;
+		r.index16 = mesh.isIndex16();
+		r.index16Eligible = !mesh.isIndex16() && mesh.vertexCount <= 65536;
+
+		for (uint32_t l = 0; l != mesh.lodCount; l++)
+			r.lods.push_back(analyzeLOD(md, mesh, l, cacheSize, positions));
+
+		const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+		const uint32_t numTriangles = r.lods.empty() ? 0 : r.lods[0].numTriangles;
+
+		if (numTriangles)
+		{
+			const MeshLODReport &lod0 = r.lods[0];
+			r.bytesPerTriangle = (float)(mesh.lodOffset[mesh.lodCount] * indexSize + (size_t)mesh.vertexCount * vertexSize) / (float)numTriangles;
+			r.score = std::max((float)numTriangles * (lod0.acmr * lod0.overdraw * lod0.overfetch - 0.5f), 0.0f);
+		} });
+
+	executor.run(taskflow).wait();
+
+	// duplicates, the same criteria as deduplicateMeshes() without the byte comparison (hash collisions are negligible for a report)
+	std::unordered_map<uint64_t, std::vector<uint32_t>> groups;
+
+	for (uint32_t i = 0; i != numMeshes; i++)
+	{
+		const Mesh &mesh = md.meshes[i];
+		const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+		const void *indices =
+			mesh.isIndex16() ? (const void *)(md.indexData16.data() + mesh.indexOffset) : (const void *)(md.indexData.data() + mesh.indexOffset);
+
+		uint64_t hash = hashBytes(md.vertexData.data() + (size_t)mesh.vertexOffset * vertexSize, (size_t)mesh.vertexCount * vertexSize);
+		hash = hashBytes(indices, mesh.lodOffset[mesh.lodCount] * indexSize, hash);
+		hash = hashBytes(&mesh.materialID, sizeof(mesh.materialID), hash);
+
+		groups[hash].push_back(i);
+	}
+
+	for (const auto &g : groups)
+		for (uint32_t m : g.second)
+			reports[m].numDuplicates = (uint32_t)g.second.size() - 1;
+
+	std::stable_sort(
+		reports.begin(), reports.end(), [](const MeshReport &a, const MeshReport &b)
+		{ return a.score != b.score ? a.score > b.score : a.numDuplicates > b.numDuplicates; });
+
+	return reports;
+}
+
+bool saveMeshReport(const char *fileName, const char *meshFile, const MeshData &md, const std::vector<MeshReport> &reports)
+{
+	FILE *f = fopen(fileName, "w");
+
+	if (!f)
+	{
+		printf("Cannot write the mesh report %s\n", fileName);
+		return false;
+	}
+
+	SCOPE_EXIT
+	{
+		fclose(f);
+	};
+
+	uint64_t numTriangles = 0;
+	uint32_t numIndex16Eligible = 0;
+	uint32_t numDuplicates = 0;
+
+	for (const MeshReport &r : reports)
+	{
+		numTriangles += r.lods.empty() ? 0 : r.lods[0].numTriangles;
+		numIndex16Eligible += r.index16Eligible ? 1 : 0;
+		numDuplicates += r.numDuplicates ? 1 : 0;
+	}
+
+	const size_t totalBytes = md.vertexData.size() + md.indexData.size() * sizeof(uint32_t) + md.indexData16.size() * sizeof(uint16_t);
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"file\": \"%s\",\n", replaceAll(meshFile, "\\", "/").c_str());
+	fprintf(f, "  \"summary\": {\n");
+	fprintf(f, "    \"meshes\": %u,\n", (uint32_t)reports.size());
+	fprintf(f, "    \"vertices\": %u,\n", (uint32_t)(md.vertexData.size() / md.streams.getVertexSize()));
+	fprintf(f, "    \"lod0Triangles\": %llu,\n", (unsigned long long)numTriangles);
+	fprintf(f, "    \"geometryBytes\": %llu,\n", (unsigned long long)totalBytes);
+	fprintf(f, "    \"bytesPerTriangle\": %.3f,\n", numTriangles ? (double)totalBytes / (double)numTriangles : 0.0);
+	fprintf(f, "    \"index16Eligible\": %u,\n", numIndex16Eligible);
+	fprintf(f, "    \"meshesWithDuplicates\": %u\n", numDuplicates);
+	fprintf(f, "  },\n");
+	fprintf(f, "  \"meshes\": [");
+
+	for (size_t i = 0; i != reports.size(); i++)
+	{
+		const MeshReport &r = reports[i];
+
+		fprintf(f, "%s\n    {\n", i ? "," : "");
+		fprintf(f, "      \"mesh\": %u,\n", r.mesh);
+		fprintf(f, "      \"material\": %u,\n", r.materialID);
+		fprintf(f, "      \"vertices\": %u,\n", r.vertexCount);
+		fprintf(f, "      \"indexFormat\": \"%s\",\n", r.index16 ? "uint16" : "uint32");
+		fprintf(f, "      \"index16Eligible\": %s,\n", r.index16Eligible ? "true" : "false");
+		fprintf(f, "      \"duplicates\": %u,\n", r.numDuplicates);
+		fprintf(f, "      \"bytesPerTriangle\": %.3f,\n", r.bytesPerTriangle);
+		fprintf(f, "      \"score\": %.1f,\n", r.score);
+		fprintf(f, "      \"lods\": [");
+		for (size_t l = 0; l != r.lods.size(); l++)
+		{
+			const MeshLODReport &lod = r.lods[l];
+			fprintf(
+				f,
+				"%s\n        { \"triangles\": %u, \"acmr\": %.3f, \"atvr\": %.3f, \"overdraw\": %.3f, \"overfetch\": %.3f, "
+				"\"bytesPerTriangle\": %.3f, \"error\": %g }",
+				l ? "," : "", lod.numTriangles, lod.acmr, lod.atvr, lod.overdraw, lod.overfetch, lod.bytesPerTriangle, lod.error);
+		}
+		fprintf(f, "\n      ]\n    }");
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+
+	return true;
+}
+
+bool writeMeshReport(const char *meshFile, const char *reportFile)
+{
+	if (!isMeshDataValid(meshFile))
+	{
+		printf("Cannot load %s\n", meshFile);
+		return false;
+	}
+
+	MeshData md;
+	loadMeshData(meshFile, md);
+
+	printf("Analyzing %u meshes from %s...\n", (uint32_t)md.meshes.size(), meshFile);
+
+	const std::vector<MeshReport> reports = analyzeMeshes(md);
+
+	if (!saveMeshReport(reportFile, meshFile, md, reports))
+		return false;
+
+	printf("Mesh report saved to %s\n", reportFile);
+
+	return true;
+}
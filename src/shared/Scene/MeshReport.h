@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "shared/Scene/VtxData.h"
+
+/* Offline efficiency report of converted geometry, works on any .meshes file. Every LOD of every mesh is run through the
+   meshoptimizer analyzers (post-transform vertex cache, overdraw and vertex fetch). The meshes are sorted by the estimated
+   wasted work, so the worst offenders come first.
+ */
+struct MeshLODReport
+{
+	uint32_t numTriangles = 0;
+	// post-transform cache: average transformed vertices per triangle (0.5 is ideal for large grids) and per vertex (1.0 is ideal)
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+	// pixels shaded / pixels covered, 1.0 is ideal
+	float overdraw = 0.0f;
+	// bytes fetched / vertex data size, 1.0 is ideal
+	float overfetch = 0.0f;
+	// the indices of this LOD and all vertices of the mesh
+	float bytesPerTriangle = 0.0f;
+	float error = 0.0f;
+};
+
+struct MeshReport
+{
+	uint32_t mesh = 0;
+	uint32_t materialID = 0;
+	uint32_t vertexCount = 0;
+	bool index16 = false;
+	// 32-bit indices while the vertex count fits into 16 bits
+	bool index16Eligible = false;
+	// other meshes with byte-identical vertices, indices and material (see deduplicateMeshes())
+	uint32_t numDuplicates = 0;
+	// all LODs and vertices per LOD0 triangle
+	float bytesPerTriangle = 0.0f;
+	// LOD0 triangles * (acmr * overdraw * overfetch - 0.5), i.e. the work spent above an ideal mesh of the same size
+	float score = 0.0f;
+	std::vector<MeshLODReport> lods;
+};
+
+// sorted by MeshReport::score, worst first; cacheSize is the simulated post-transform cache size
+std::vector<MeshReport> analyzeMeshes(const MeshData &md, uint32_t cacheSize = 16);
+
+// JSON with a summary and the sorted per-mesh reports
+bool saveMeshReport(const char *fileName, const char *meshFile, const MeshData &md, const std::vector<MeshReport> &reports);
+
+// load a .meshes file, analyze it and save the JSON report
+bool writeMeshReport(const char *meshFile, const char *reportFile);
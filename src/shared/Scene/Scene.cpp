@@ -4,7 +4,7 @@
 #include <algorithm>
 #include <numeric>
 
-int addNode(Scene &scene, int parent, int level)
+int addNode(Scene &scene, int parent, int level, int mesh, int material)
 {
 	const int node = (int)scene.hierarchy.size();
 	{
@@ -45,9 +45,145 @@ int addNode(Scene &scene, int parent, int level)
 	scene.hierarchy[node].nextSibling = -1;
 	scene.hierarchy[node].firstChild = -1;
 
+	if (mesh > -1)
+		setNodeMesh(scene, node, (uint32_t)mesh);
+	if (material > -1)
+		setNodeMaterial(scene, node, (uint32_t)material);
+
 	return node;
 }
 
+// Keep the reverse lists sorted: new nodes are appended, so this is usually a push_back()
+static void addToReverseMap(std::unordered_map<uint32_t, std::vector<uint32_t>> &map, uint32_t item, uint32_t node)
+{
+	std::vector<uint32_t> &nodes = map[item];
+	nodes.insert(std::upper_bound(nodes.begin(), nodes.end(), node), node);
+}
+
+static void removeFromReverseMap(std::unordered_map<uint32_t, std::vector<uint32_t>> &map, uint32_t item, uint32_t node)
+{
+	const auto i = map.find(item);
+
+	if (i == map.end())
+		return;
+
+	std::vector<uint32_t> &nodes = i->second;
+	const auto n = std::lower_bound(nodes.begin(), nodes.end(), node);
+
+	if (n != nodes.end() && *n == node)
+		nodes.erase(n);
+
+	if (nodes.empty())
+		map.erase(i);
+}
+
+static void setNodeComponent(
+	std::unordered_map<uint32_t, uint32_t> &forward, std::unordered_map<uint32_t, std::vector<uint32_t>> &reverse, int node, uint32_t item)
+{
+	const auto i = forward.find(node);
+
+	if (i != forward.end())
+	{
+		if (i->second == item)
+			return;
+		removeFromReverseMap(reverse, i->second, node);
+	}
+
+	forward[node] = item;
+	addToReverseMap(reverse, item, node);
+}
+
+void setNodeMesh(Scene &scene, int node, uint32_t mesh)
+{
+	setNodeComponent(scene.meshForNode, scene.nodesForMesh, node, mesh);
+}
+
+void setNodeMaterial(Scene &scene, int node, uint32_t material)
+{
+	setNodeComponent(scene.materialForNode, scene.nodesForMaterial, node, material);
+}
+
+static void removeNodeComponent(
+	std::unordered_map<uint32_t, uint32_t> &forward, std::unordered_map<uint32_t, std::vector<uint32_t>> &reverse, int node)
+{
+	const auto i = forward.find(node);
+
+	if (i == forward.end())
+		return;
+
+	removeFromReverseMap(reverse, i->second, node);
+	forward.erase(i);
+}
+
+void removeNodeMesh(Scene &scene, int node)
+{
+	removeNodeComponent(scene.meshForNode, scene.nodesForMesh, node);
+}
+
+void removeNodeMaterial(Scene &scene, int node)
+{
+	removeNodeComponent(scene.materialForNode, scene.nodesForMaterial, node);
+}
+
+static void remapComponent(
+	std::unordered_map<uint32_t, uint32_t> &forward, std::unordered_map<uint32_t, std::vector<uint32_t>> &reverse,
+	const std::vector<uint32_t> &oldToNew)
+{
+	for (auto &n : forward)
+		n.second = oldToNew[n.second];
+
+	std::unordered_map<uint32_t, std::vector<uint32_t>> remapped;
+	remapped.reserve(reverse.size());
+
+	for (auto &r : reverse)
+	{
+		std::vector<uint32_t> &nodes = remapped[oldToNew[r.first]];
+
+		if (nodes.empty())
+		{
+			nodes = std::move(r.second);
+			continue;
+		}
+
+		// both lists are sorted
+		const size_t middle = nodes.size();
+		nodes.insert(nodes.end(), r.second.begin(), r.second.end());
+		std::inplace_merge(nodes.begin(), nodes.begin() + middle, nodes.end());
+	}
+
+	reverse = std::move(remapped);
+}
+
+void remapNodeMeshes(Scene &scene, const std::vector<uint32_t> &oldToNew)
+{
+	remapComponent(scene.meshForNode, scene.nodesForMesh, oldToNew);
+}
+
+void remapNodeMaterials(Scene &scene, const std::vector<uint32_t> &oldToNew)
+{
+	remapComponent(scene.materialForNode, scene.nodesForMaterial, oldToNew);
+}
+
+static void invertMap(
+	const std::unordered_map<uint32_t, uint32_t> &forward, std::unordered_map<uint32_t, std::vector<uint32_t>> &reverse, size_t numNodes)
+{
+	reverse.clear();
+
+	// iterate nodes in order so that every list comes out sorted
+	for (uint32_t node = 0; node != numNodes; node++)
+	{
+		const auto i = forward.find(node);
+		if (i != forward.end())
+			reverse[i->second].push_back(node);
+	}
+}
+
+void recalculateReverseComponents(Scene &scene)
+{
+	invertMap(scene.meshForNode, scene.nodesForMesh, scene.hierarchy.size());
+	invertMap(scene.materialForNode, scene.nodesForMaterial, scene.hierarchy.size());
+}
+
 void markAsChanged(Scene &scene, int node)
 {
 	const int level = scene.hierarchy[node].level;
@@ -155,10 +291,15 @@ void loadScene(const char *fileName, Scene &scene)
 		loadMap(f, scene.nameForNode);
 		loadStringList(f, scene.nodeNames);
 		loadStringList(f, scene.materialNames);
+		// the node flags are optional, older files end after the names
+		loadMap(f, scene.flagsForNode);
 	}
 
 	fclose(f);
 
+	// reverse components are not serialized
+	recalculateReverseComponents(scene);
+
 	markAsChanged(scene, 0);
 	recalculateGlobalTransforms(scene);
 }
@@ -192,11 +333,13 @@ void saveScene(const char *fileName, const Scene &scene)
 	saveMap(f, scene.materialForNode);
 	saveMap(f, scene.meshForNode);
 
-	if (!scene.nodeNames.empty() && !scene.nameForNode.empty())
+	if ((!scene.nodeNames.empty() && !scene.nameForNode.empty()) || !scene.flagsForNode.empty())
 	{
 		saveMap(f, scene.nameForNode);
 		saveStringList(f, scene.nodeNames);
 		saveStringList(f, scene.materialNames);
+		if (!scene.flagsForNode.empty())
+			saveMap(f, scene.flagsForNode);
 	}
 	fclose(f);
 }
@@ -303,6 +446,20 @@ void mergeMaps(ItemMap &m, const ItemMap &otherMap, int indexOffset, int itemOff
 		m[i.first + indexOffset] = i.second + itemOffset;
 }
 
+using ReverseItemMap = std::unordered_map<uint32_t, std::vector<uint32_t>>;
+
+// Same as mergeMaps() for the reverse components. Scenes are appended in order, so all node lists stay sorted
+void mergeReverseMaps(ReverseItemMap &m, const ReverseItemMap &otherMap, int indexOffset, int itemOffset)
+{
+	for (const auto &i : otherMap)
+	{
+		std::vector<uint32_t> &nodes = m[i.first + itemOffset];
+		nodes.reserve(nodes.size() + i.second.size());
+		for (uint32_t n : i.second)
+			nodes.push_back(n + indexOffset);
+	}
+}
+
 /**
   There are different use cases for scene merging.
   The simplest one is the direct "gluing" of multiple scenes into one [all the material lists and mesh lists are merged and indices in all
@@ -360,6 +517,9 @@ void mergeScenes(
 		mergeMaps(scene.meshForNode, s->meshForNode, offs, mergeMeshes ? meshOffs : 0);
 		mergeMaps(scene.materialForNode, s->materialForNode, offs, mergeMaterials ? materialOfs : 0);
 		mergeMaps(scene.nameForNode, s->nameForNode, offs, nameOffs);
+		mergeMaps(scene.flagsForNode, s->flagsForNode, offs, 0);
+		mergeReverseMaps(scene.nodesForMesh, s->nodesForMesh, offs, mergeMeshes ? meshOffs : 0);
+		mergeReverseMaps(scene.nodesForMaterial, s->nodesForMaterial, offs, mergeMaterials ? materialOfs : 0);
 
 		offs += nodeCount;
 
@@ -481,6 +641,27 @@ void shiftMapIndices(std::unordered_map<uint32_t, uint32_t> &items, const std::v
 	items = newItems;
 }
 
+// newIndices[] is monotonic for the surviving nodes, so the shifted lists remain sorted
+void shiftReverseMapIndices(std::unordered_map<uint32_t, std::vector<uint32_t>> &items, const std::vector<int> &newIndices)
+{
+	for (auto i = items.begin(); i != items.end();)
+	{
+		std::vector<uint32_t> &nodes = i->second;
+		size_t numNodes = 0;
+
+		for (uint32_t n : nodes)
+		{
+			const int newIndex = newIndices[n];
+			if (newIndex != -1)
+				nodes[numNodes++] = (uint32_t)newIndex;
+		}
+
+		nodes.resize(numNodes);
+
+		i = nodes.empty() ? items.erase(i) : std::next(i);
+	}
+}
+
 // Approximately an O ( N * Log(N) * Log(M)) algorithm (N = scene.size, M = nodesToDelete.size) to delete a collection of nodes from scene
 // graph
 void deleteSceneNodes(Scene &scene, const std::vector<uint32_t> &nodesToDelete)
@@ -528,6 +709,9 @@ void deleteSceneNodes(Scene &scene, const std::vector<uint32_t> &nodesToDelete)
 	shiftMapIndices(scene.meshForNode, newIndices);
 	shiftMapIndices(scene.materialForNode, newIndices);
 	shiftMapIndices(scene.nameForNode, newIndices);
+	shiftMapIndices(scene.flagsForNode, newIndices);
+	shiftReverseMapIndices(scene.nodesForMesh, newIndices);
+	shiftReverseMapIndices(scene.nodesForMaterial, newIndices);
 
 	// 5) scene node names list is not modified, but in principle it can be (remove all non-used items and adjust the nameForNode_ map)
 	// 6) Material names list is not modified also, but if some materials fell out of use
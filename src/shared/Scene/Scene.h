@@ -27,6 +27,12 @@ struct Hierarchy
 	int level = 0;
 };
 
+enum NodeFlags
+{
+	// the node is moved at runtime (e.g. animated) together with its subtree, it must not be baked into static batches
+	sNodeFlags_Dynamic = 0x1,
+};
+
 /* This scene is converted into a descriptorSet(s) in MultiRenderer class
    This structure is also used as a storage type in SceneExporter tool
  */
@@ -49,9 +55,18 @@ struct Scene
 	// Material component: which material belongs to which node (Node -> Material)
 	std::unordered_map<uint32_t, uint32_t> materialForNode;
 
+	// Reverse mesh component: which nodes use a mesh (Mesh -> sorted list of Nodes)
+	std::unordered_map<uint32_t, std::vector<uint32_t>> nodesForMesh;
+
+	// Reverse material component: which nodes use a material (Material -> sorted list of Nodes)
+	std::unordered_map<uint32_t, std::vector<uint32_t>> nodesForMaterial;
+
 	// Node name component: which name is assigned to the node (Node -> Name)
 	std::unordered_map<uint32_t, uint32_t> nameForNode;
 
+	// Node flags component: a combination of NodeFlags for the nodes that have any (Node -> Flags)
+	std::unordered_map<uint32_t, uint32_t> flagsForNode;
+
 	// List of scene node names
 	std::vector<std::string> nodeNames;
 
@@ -59,7 +74,46 @@ struct Scene
 	std::vector<std::string> materialNames;
 };
 
-int addNode(Scene &scene, int parent, int level);
+int addNode(Scene &scene, int parent, int level, int mesh = -1, int material = -1);
+
+// Assign components to a node keeping the reverse indices (nodesForMesh/nodesForMaterial) up to date
+void setNodeMesh(Scene &scene, int node, uint32_t mesh);
+void setNodeMaterial(Scene &scene, int node, uint32_t material);
+void removeNodeMesh(Scene &scene, int node);
+void removeNodeMaterial(Scene &scene, int node);
+
+// Apply a remap of the mesh (material) indices, e.g. after some meshes were erased or collapsed. Only the keys of nodesForMesh
+// (nodesForMaterial) change, the node lists of the items remapped to the same index are merged
+void remapNodeMeshes(Scene &scene, const std::vector<uint32_t> &oldToNew);
+void remapNodeMaterials(Scene &scene, const std::vector<uint32_t> &oldToNew);
+
+// Rebuild nodesForMesh/nodesForMaterial from meshForNode/materialForNode, e.g. after loading a scene. O(number of nodes)
+void recalculateReverseComponents(Scene &scene);
+
+inline const std::vector<uint32_t> &getNodesWithMesh(const Scene &scene, uint32_t mesh)
+{
+	static const std::vector<uint32_t> empty;
+	const auto i = scene.nodesForMesh.find(mesh);
+	return i != scene.nodesForMesh.end() ? i->second : empty;
+}
+
+inline const std::vector<uint32_t> &getNodesWithMaterial(const Scene &scene, uint32_t material)
+{
+	static const std::vector<uint32_t> empty;
+	const auto i = scene.nodesForMaterial.find(material);
+	return i != scene.nodesForMaterial.end() ? i->second : empty;
+}
+
+inline bool isNodeDynamic(const Scene &scene, uint32_t node)
+{
+	const auto i = scene.flagsForNode.find(node);
+	return i != scene.flagsForNode.end() && (i->second & sNodeFlags_Dynamic);
+}
+
+inline void setNodeDynamic(Scene &scene, uint32_t node)
+{
+	scene.flagsForNode[node] |= sNodeFlags_Dynamic;
+}
 
 void markAsChanged(Scene &scene, int node);
 
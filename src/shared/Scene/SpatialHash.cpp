@@ -0,0 +1,167 @@
+#include "shared/Scene/SpatialHash.h"
+
+#include <algorithm>
+#include <assert.h>
+
+// 21 bits per axis, biased to keep negative coordinates
+static uint64_t cellKey(const glm::ivec3 &c)
+{
+	constexpr int kBias = 1 << 20;
+	constexpr uint64_t kMask = (1ull << 21) - 1;
+
+	return (uint64_t(c.x + kBias) & kMask) | ((uint64_t(c.y + kBias) & kMask) << 21) | ((uint64_t(c.z + kBias) & kMask) << 42);
+}
+
+static glm::ivec3 cellCoords(const SpatialHash &hash, const vec3 &p)
+{
+	return glm::ivec3(glm::floor(p / hash.cellSize));
+}
+
+static bool isOversized(const SpatialHash &hash, const BoundingBox &box)
+{
+	const vec3 size = box.getSize();
+	return std::max(std::max(size.x, size.y), size.z) > hash.cellSize;
+}
+
+static bool boxesOverlap(const BoundingBox &a, const BoundingBox &b)
+{
+	return a.min_.x <= b.max_.x && a.max_.x >= b.min_.x && a.min_.y <= b.max_.y && a.max_.y >= b.min_.y && a.min_.z <= b.max_.z &&
+		   a.max_.z >= b.min_.z;
+}
+
+void spatialHashInit(SpatialHash &hash, float cellSize, size_t numItems)
+{
+	assert(cellSize > 0.0f);
+
+	hash.cellSize = cellSize;
+	hash.items.clear();
+	hash.items.resize(numItems);
+	hash.cells.clear();
+	hash.oversized.clear();
+}
+
+void spatialHashRemove(SpatialHash &hash, uint32_t id)
+{
+	if (id >= hash.items.size() || !hash.items[id].inserted)
+		return;
+
+	SpatialHash::Item &item = hash.items[id];
+
+	const auto cell = item.isOversized ? hash.cells.end() : hash.cells.find(item.cell);
+	std::vector<uint32_t> &list = item.isOversized ? hash.oversized : cell->second;
+
+	// swap'n'pop
+	const uint32_t last = list.back();
+	list[item.slot] = last;
+	hash.items[last].slot = item.slot;
+	list.pop_back();
+
+	if (!item.isOversized && list.empty())
+		hash.cells.erase(cell);
+
+	item.inserted = false;
+}
+
+void spatialHashUpdate(SpatialHash &hash, uint32_t id, const BoundingBox &box)
+{
+	if (id >= hash.items.size())
+		hash.items.resize(id + 1);
+
+	SpatialHash::Item &item = hash.items[id];
+
+	const bool oversized = isOversized(hash, box);
+	const uint64_t key = oversized ? 0 : cellKey(cellCoords(hash, box.getCenter()));
+
+	// still in the same cell: nothing to relink
+	if (item.inserted && item.isOversized == oversized && (oversized || item.cell == key))
+	{
+		item.box = box;
+		return;
+	}
+
+	spatialHashRemove(hash, id);
+
+	std::vector<uint32_t> &list = oversized ? hash.oversized : hash.cells[key];
+
+	item = {
+		.box = box,
+		.cell = key,
+		.slot = (uint32_t)list.size(),
+		.inserted = true,
+		.isOversized = oversized,
+	};
+
+	list.push_back(id);
+}
+
+void spatialHashQuery(const SpatialHash &hash, const BoundingBox &box, std::vector<uint32_t> &result)
+{
+	auto testList = [&hash, &box, &result](const std::vector<uint32_t> &list)
+	{
+		for (uint32_t id : list)
+			if (boxesOverlap(hash.items[id].box, box))
+				result.push_back(id);
+	};
+
+	testList(hash.oversized);
+
+	// an item can stick out of its cell by at most half of the cell size
+	const vec3 looseMargin(0.5f * hash.cellSize);
+	const glm::ivec3 cmin = cellCoords(hash, box.min_ - looseMargin);
+	const glm::ivec3 cmax = cellCoords(hash, box.max_ + looseMargin);
+
+	const uint64_t numCellsInRange = uint64_t(cmax.x - cmin.x + 1) * uint64_t(cmax.y - cmin.y + 1) * uint64_t(cmax.z - cmin.z + 1);
+
+	// huge queries: cheaper to walk the occupied cells than to probe every cell in range
+	if (numCellsInRange > hash.cells.size())
+	{
+		for (const auto &c : hash.cells)
+			testList(c.second);
+		return;
+	}
+
+	for (int z = cmin.z; z <= cmax.z; z++)
+		for (int y = cmin.y; y <= cmax.y; y++)
+			for (int x = cmin.x; x <= cmax.x; x++)
+			{
+				const auto c = hash.cells.find(cellKey(glm::ivec3(x, y, z)));
+				if (c != hash.cells.end())
+					testList(c->second);
+			}
+}
+
+void spatialHashQueryFrustum(const SpatialHash &hash, glm::vec4 *frustumPlanes, glm::vec4 *frustumCorners, std::vector<uint32_t> &result)
+{
+	auto testList = [&hash, frustumPlanes, frustumCorners, &result](const std::vector<uint32_t> &list)
+	{
+		for (uint32_t id : list)
+			if (isBoxInFrustum(frustumPlanes, frustumCorners, hash.items[id].box))
+				result.push_back(id);
+	};
+
+	testList(hash.oversized);
+
+	for (const auto &c : hash.cells)
+	{
+		// all items of a cell share the cell's loose bounds - reject them at once
+		const uint32_t id = c.second.front();
+		const vec3 cell = vec3(cellCoords(hash, hash.items[id].box.getCenter())) * hash.cellSize;
+		const BoundingBox looseBounds(cell - vec3(0.5f * hash.cellSize), cell + vec3(1.5f * hash.cellSize));
+
+		if (isBoxInFrustum(frustumPlanes, frustumCorners, looseBounds))
+			testList(c.second);
+	}
+}
+
+void updateSpatialHash(SpatialHash &hash, const Scene &scene, std::span<const BoundingBox> meshBoxes, std::span<const int> movedNodes)
+{
+	for (int node : movedNodes)
+	{
+		const auto mesh = scene.meshForNode.find((uint32_t)node);
+
+		if (mesh == scene.meshForNode.end())
+			continue;
+
+		spatialHashUpdate(hash, (uint32_t)node, meshBoxes[mesh->second].getTransformed(scene.globalTransform[node]));
+	}
+}
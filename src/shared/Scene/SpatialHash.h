@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "shared/Scene/Scene.h"
+#include "shared/UtilsMath.h"
+
+/* Loose uniform grid for dynamic objects, hashed by integer cell coordinates.
+   Every item lives in exactly one cell: the one containing the center of its world AABB.
+   A cell is "loose", i.e. its effective bounds are extended by half of the cell size in every direction,
+   so any item not larger than cellSize is fully contained by the loose bounds of its cell.
+   Larger items are kept in a separate list which is tested by every query.
+   Updating an item which did not cross a cell boundary is O(1), no rebuild is ever needed.
+ */
+struct SpatialHash
+{
+	float cellSize = 1.0f;
+
+	struct Item
+	{
+		BoundingBox box;
+		uint64_t cell = 0;
+		uint32_t slot = 0; // position inside cells[cell] or oversized
+		bool inserted = false;
+		bool isOversized = false;
+	};
+
+	// indexed by item id (i.e., scene node)
+	std::vector<Item> items;
+
+	// cell key -> item ids
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+
+	// items larger than cellSize
+	std::vector<uint32_t> oversized;
+};
+
+void spatialHashInit(SpatialHash &hash, float cellSize, size_t numItems = 0);
+
+// insert a new item or move an existing one
+void spatialHashUpdate(SpatialHash &hash, uint32_t id, const BoundingBox &box);
+void spatialHashRemove(SpatialHash &hash, uint32_t id);
+
+// append ids of all items whose AABBs overlap the box
+void spatialHashQuery(const SpatialHash &hash, const BoundingBox &box, std::vector<uint32_t> &result);
+
+// append ids of all items whose AABBs are inside the frustum (uses isBoxInFrustum())
+void spatialHashQueryFrustum(const SpatialHash &hash, glm::vec4 *frustumPlanes, glm::vec4 *frustumCorners, std::vector<uint32_t> &result);
+
+// Re-insert the world AABBs of moved nodes, e.g. the contents of scene.changedAtThisFrame collected before
+// recalculateGlobalTransforms() consumes them. Nodes without a mesh are ignored. meshBoxes are in mesh space (MeshDataView::boxes)
+void updateSpatialHash(SpatialHash &hash, const Scene &scene, std::span<const BoundingBox> meshBoxes, std::span<const int> movedNodes);
@@ -1,8 +1,272 @@
 #include "shared/Scene/VtxData.h"
+#include "shared/Scene/Scene.h"
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <stdio.h>
+#include <type_traits>
+#include <utility>
+
+#include <meshoptimizer.h>
+
+#include <taskflow/taskflow.hpp>
+#include <taskflow/algorithm/for_each.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static bool seekFile(FILE *f, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(f, (int64_t)offset, SEEK_SET) == 0;
+#else
+	return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t getFileSize(FILE *f)
+{
+#if defined(_WIN32)
+	if (_fseeki64(f, 0, SEEK_END))
+		return 0;
+	const int64_t size = _ftelli64(f);
+#else
+	if (fseeko(f, 0, SEEK_END))
+		return 0;
+	const off_t size = ftello(f);
+#endif
+	return size > 0 ? (uint64_t)size : 0;
+}
+
+static uint64_t alignSectionOffset(uint64_t offset)
+{
+	return (offset + 15) & ~uint64_t(15);
+}
+
+// v1 files are a fixed sequence of sections without checksums
+static std::vector<MeshFileSection> getSectionsV1(const MeshFileHeader &header)
+{
+	// up to the OBBs, v1 files are never compressed
+	const uint64_t sizes[] = {
+		sizeof(lvk::VertexInput),
+		sizeof(Mesh) * (uint64_t)header.meshCount,
+		sizeof(BoundingBox) * (uint64_t)header.meshCount,
+		header.indexDataSize,
+		header.vertexDataSize,
+		0, // v1 files have only 32-bit indices
+		0, // no meshlets
+		0, // no bounding spheres
+		0, // and no oriented bounding boxes
+	};
+
+	static_assert(std::size(sizes) == MeshFileSection_OBBs + 1);
+
+	std::vector<MeshFileSection> sections;
+	sections.reserve(std::size(sizes));
+
+	uint64_t offset = sizeof(MeshFileHeader);
+
+	for (uint32_t i = 0; i != std::size(sizes); i++)
+	{
+		sections.push_back({.type = i, .offset = offset, .size = sizes[i]});
+		offset += sizes[i];
+	}
+
+	return sections;
+}
+
+// the per-chunk checksums of a v2 file, empty for v1 files
+struct MeshFileChecksums
+{
+	uint32_t chunkSize = 0;
+	std::vector<uint64_t> chunks;
+};
+
+static uint64_t getNumChunks(uint64_t size, uint32_t chunkSize)
+{
+	return (size + chunkSize - 1) / chunkSize;
+}
+
+// reads the table of contents of a v1 or v2 file and checks that every section fits into the file
+static bool readTableOfContents(FILE *f, std::vector<MeshFileSection> &sections, MeshFileChecksums &checksums)
+{
+	const uint64_t fileSize = getFileSize(f);
+
+	MeshFileHeader header;
+
+	if (!seekFile(f, 0) || fread(&header, 1, sizeof(header), f) != sizeof(header))
+		return false;
+
+	checksums = {};
+
+	if (header.magicValue == kMeshFileMagic)
+	{
+		sections = getSectionsV1(header);
+	}
+	else if (header.magicValue == kMeshFileMagicV2)
+	{
+		MeshFileHeaderV2 headerV2;
+
+		if (!seekFile(f, 0) || fread(&headerV2, 1, sizeof(headerV2), f) != sizeof(headerV2))
+			return false;
+
+		if (headerV2.fileSize > fileSize || !headerV2.chunkSize ||
+			sizeof(headerV2) + (uint64_t)headerV2.numSections * sizeof(MeshFileSection) + (uint64_t)headerV2.numChunks * sizeof(uint64_t) >
+				fileSize)
+			return false;
+
+		sections.resize(headerV2.numSections);
+		checksums.chunkSize = headerV2.chunkSize;
+		checksums.chunks.resize(headerV2.numChunks);
+
+		if (fread(sections.data(), sizeof(MeshFileSection), sections.size(), f) != sections.size() ||
+			fread(checksums.chunks.data(), sizeof(uint64_t), checksums.chunks.size(), f) != checksums.chunks.size())
+			return false;
+
+		for (const MeshFileSection &s : sections)
+		{
+			if (s.firstChunk + getNumChunks(s.size, checksums.chunkSize) > checksums.chunks.size())
+				return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	for (const MeshFileSection &s : sections)
+	{
+		if (s.offset + s.size < s.offset || s.offset + s.size > fileSize)
+			return false;
+	}
+
+	return true;
+}
+
+// Verify the chunks of a section read into memory. The chunks are independent, so they are hashed in parallel
+static bool verifySectionChunks(const MeshFileSection &s, const void *data, const MeshFileChecksums &checksums, tf::Executor &executor)
+{
+	if (checksums.chunks.empty())
+		return true;
+
+	const uint32_t numChunks = (uint32_t)getNumChunks(s.size, checksums.chunkSize);
+
+	std::atomic<bool> success = true;
+
+	auto verifyChunk = [&](uint32_t i)
+	{
+		const uint64_t begin = (uint64_t)i * checksums.chunkSize;
+		const uint64_t size = std::min<uint64_t>(checksums.chunkSize, s.size - begin);
+
+		if (hashBytes((const uint8_t *)data + begin, size) != checksums.chunks[s.firstChunk + i])
+			success = false;
+	};
+
+	if (numChunks <= 1)
+	{
+		if (numChunks)
+			verifyChunk(0);
+		return success;
+	}
+
+	tf::Taskflow taskflow;
+	taskflow.for_each_index(0u, numChunks, 1u, verifyChunk);
+
+	executor.run(taskflow).wait();
+
+	return success;
+}
+
+static const MeshFileSection *findSection(const std::vector<MeshFileSection> &sections, uint32_t type)
+{
+	const auto i = std::find_if(sections.begin(), sections.end(), [type](const MeshFileSection &s)
+								{ return s.type == type; });
+
+	return i != sections.end() ? &*i : nullptr;
+}
+
+static bool hasSections(const std::vector<MeshFileSection> &sections, uint32_t sectionMask)
+{
+	for (uint32_t type = 0; type != MeshFileSection_Count; type++)
+	{
+		if ((sectionMask & (1u << type)) && !findSection(sections, type))
+			return false;
+	}
+
+	return true;
+}
+
+// saveMeshDataCompressed() writes the 32-bit index chunks, the 16-bit index chunks and the vertex chunks, each group sorted by the first element
+static uint32_t getChunkGroup(uint32_t flags)
+{
+	return (flags & sMeshCodecChunk_Vertex) ? 2 : (flags & sMeshCodecChunk_Index16) ? 1 : 0;
+}
+
+// the decoded sizes are not stored in compressed files: every group of chunks ends with its last element
+static void setDecodedSizes(CompressedMeshData &data)
+{
+	uint64_t numElements[3] = {};
+
+	for (const MeshCodecChunk &c : data.chunks)
+	{
+		uint64_t &n = numElements[getChunkGroup(c.flags)];
+		n = std::max(n, (uint64_t)c.firstElement + c.numElements);
+	}
+
+	data.indexDataSize = numElements[0] * sizeof(uint32_t);
+	data.indexData16Size = numElements[1] * sizeof(uint16_t);
+	data.vertexDataSize = numElements[2] * data.streams.getVertexSize();
+}
+
+// The chunks holding the indices and the vertices of a mesh, nullptr if the mesh has none. Every chunk starts at a mesh boundary, see
+// getChunkGroup() for the order. Returns false if a chunk is missing, too short or outside of the encoded data
+static bool findMeshChunks(const CompressedMeshData &data, const Mesh &mesh, const MeshCodecChunk *&indexChunk, const MeshCodecChunk *&vertexChunk)
+{
+	auto findChunk = [&data](uint32_t group, uint32_t firstElement) -> const MeshCodecChunk *
+	{
+		const auto c = std::lower_bound(
+			data.chunks.begin(), data.chunks.end(), std::make_pair(group, firstElement), [](const MeshCodecChunk &c, const auto &key)
+			{ return std::make_pair(getChunkGroup(c.flags), c.firstElement) < key; });
+
+		return c != data.chunks.end() && getChunkGroup(c->flags) == group && c->firstElement == firstElement ? &*c : nullptr;
+	};
+
+	const uint32_t numIndices = mesh.lodOffset[mesh.lodCount];
+
+	indexChunk = numIndices ? findChunk(mesh.isIndex16() ? 1 : 0, mesh.indexOffset) : nullptr;
+	vertexChunk = mesh.vertexCount ? findChunk(2, mesh.vertexOffset) : nullptr;
+
+	if ((numIndices && (!indexChunk || indexChunk->numElements < numIndices)) ||
+		(mesh.vertexCount && (!vertexChunk || vertexChunk->numElements < mesh.vertexCount)))
+	{
+		printf("Missing chunk of the mesh.\n");
+		return false;
+	}
+
+	for (const MeshCodecChunk *c : {indexChunk, vertexChunk})
+	{
+		if (c && (c->encodedOffset > data.encodedData.size() || c->encodedSize > data.encodedData.size() - c->encodedOffset))
+		{
+			printf("Corrupted chunk descriptor.\n");
+			return false;
+		}
+	}
+
+	return true;
+}
 
 bool isMeshDataValid(const char *fileName)
 {
@@ -21,21 +285,51 @@ bool isMeshDataValid(const char *fileName)
 	if (fread(&header, 1, sizeof(header), f) != sizeof(header))
 		return false;
 
-	if (fseek(f, sizeof(Mesh) * header.meshCount, SEEK_CUR))
+	if (header.magicValue == kMeshFileMagicV2)
+	{
+		std::vector<MeshFileSection> sections;
+		MeshFileChecksums checksums;
+
+		if (!readTableOfContents(f, sections, checksums))
+			return false;
+
+		const MeshFileSection *codecChunks = findSection(sections, MeshFileSection_CodecChunks);
+
+		if (!hasSections(sections, sMeshFileSectionBits_Metadata | (codecChunks ? sMeshFileSectionBits_Encoded : sMeshFileSectionBits_Geometry)))
+			return false;
+
+		if (codecChunks && codecChunks->size % sizeof(MeshCodecChunk))
+			return false;
+
+		// a different sizeof(Mesh) means the file was written by an incompatible version
+		const uint64_t meshesSize = findSection(sections, MeshFileSection_Meshes)->size;
+		const uint64_t numMeshes = meshesSize / sizeof(Mesh);
+
+		return meshesSize % sizeof(Mesh) == 0 && numMeshes == findSection(sections, MeshFileSection_Boxes)->size / sizeof(BoundingBox) &&
+			   numMeshes == findSection(sections, MeshFileSection_Spheres)->size / sizeof(BoundingSphere) &&
+			   numMeshes == findSection(sections, MeshFileSection_OBBs)->size / sizeof(OrientedBoundingBox);
+	}
+
+	if (header.magicValue != kMeshFileMagic)
 		return false;
 
-	if (fseek(f, sizeof(BoundingBox) * header.meshCount, SEEK_CUR))
+	if (fseek(f, sizeof(lvk::VertexInput), SEEK_CUR))
 		return false;
 
-	if (fseek(f, header.indexDataSize, SEEK_CUR))
+	if (fseek(f, sizeof(Mesh) * header.meshCount, SEEK_CUR))
 		return false;
 
-	if (fseek(f, header.vertexDataSize, SEEK_CUR))
+	if (fseek(f, sizeof(BoundingBox) * header.meshCount, SEEK_CUR))
 		return false;
 
-	return true;
+	// fseek() does not fail beyond the end of the file, and files with a different sizeof(Mesh) have to be rejected
+	const uint64_t expectedSize = sizeof(header) + sizeof(lvk::VertexInput) + (sizeof(Mesh) + sizeof(BoundingBox)) * (uint64_t)header.meshCount +
+								  header.indexDataSize + header.vertexDataSize;
+
+	return getFileSize(f) == expectedSize;
 }
 
+// Walks the layout written by saveScene() and checks that every component fits into the file, which fopen() alone did not catch
 bool isMeshHierarchyValid(const char *fileName)
 {
 	FILE *f = fopen(fileName, "rb");
@@ -48,7 +342,70 @@ bool isMeshHierarchyValid(const char *fileName)
 		fclose(f);
 	};
 
-	return true;
+	const uint64_t fileSize = getFileSize(f);
+
+	if (fseek(f, 0, SEEK_SET))
+		return false;
+
+	uint32_t numNodes = 0;
+	if (fread(&numNodes, 1, sizeof(numNodes), f) != sizeof(numNodes) || !numNodes)
+		return false;
+
+	// local transforms, global transforms and the hierarchy
+	uint64_t offset = sizeof(numNodes) + (2 * sizeof(glm::mat4) + sizeof(Hierarchy)) * (uint64_t)numNodes;
+
+	if (offset > fileSize || fseek(f, (long)(offset - sizeof(numNodes)), SEEK_CUR))
+		return false;
+
+	// a map is stored as a number of values followed by (key, value) pairs, one pair per node at most
+	auto skipMap = [f, fileSize, numNodes, &offset]() -> bool
+	{
+		uint32_t sz = 0;
+		if (fread(&sz, 1, sizeof(sz), f) != sizeof(sz) || sz % 2 || sz / 2 > numNodes)
+			return false;
+
+		offset += sizeof(sz) + sizeof(uint32_t) * (uint64_t)sz;
+
+		return offset <= fileSize && fseek(f, (long)(sizeof(uint32_t) * sz), SEEK_CUR) == 0;
+	};
+
+	// see saveStringList(): every string is stored with its length and the terminating zero
+	auto skipStringList = [f, fileSize, &offset]() -> bool
+	{
+		uint32_t numStrings = 0;
+		if (fread(&numStrings, 1, sizeof(numStrings), f) != sizeof(numStrings))
+			return false;
+
+		offset += sizeof(numStrings);
+
+		for (uint32_t i = 0; i != numStrings; i++)
+		{
+			uint32_t length = 0;
+			if (fread(&length, 1, sizeof(length), f) != sizeof(length))
+				return false;
+
+			offset += sizeof(length) + (uint64_t)length + 1;
+
+			if (offset > fileSize || fseek(f, (long)length + 1, SEEK_CUR))
+				return false;
+		}
+
+		return true;
+	};
+
+	// materialForNode and meshForNode
+	if (!skipMap() || !skipMap())
+		return false;
+
+	// the node names are optional
+	if (offset == fileSize)
+		return true;
+
+	if (!skipMap() || !skipStringList() || !skipStringList())
+		return false;
+
+	// so are the node flags
+	return offset == fileSize || (skipMap() && offset == fileSize);
 }
 
 bool isMeshMaterialsValid(const char *fileName)
@@ -76,7 +433,181 @@ bool isMeshMaterialsValid(const char *fileName)
 	return true;
 }
 
-MeshFileHeader loadMeshData(const char *meshFile, MeshData &out)
+bool loadMeshFileSections(const char *meshFile, std::vector<MeshFileSection> &sections, bool *hasChecksums)
+{
+	FILE *f = fopen(meshFile, "rb");
+
+	if (!f)
+	{
+		printf("Cannot open '%s'.\n", meshFile);
+		return false;
+	}
+
+	SCOPE_EXIT
+	{
+		fclose(f);
+	};
+
+	MeshFileChecksums checksums;
+
+	if (!readTableOfContents(f, sections, checksums))
+	{
+		printf("Unable to read the table of contents of '%s'.\n", meshFile);
+		return false;
+	}
+
+	if (hasChecksums)
+		*hasChecksums = !checksums.chunks.empty();
+
+	return true;
+}
+
+bool loadMeshDataSections(const char *meshFile, uint32_t sectionMask, MeshData &out)
+{
+	FILE *f = fopen(meshFile, "rb");
+
+	if (!f)
+	{
+		printf("Cannot open '%s'.\n", meshFile);
+		return false;
+	}
+
+	SCOPE_EXIT
+	{
+		fclose(f);
+	};
+
+	std::vector<MeshFileSection> sections;
+	MeshFileChecksums checksums;
+
+	if (!readTableOfContents(f, sections, checksums))
+	{
+		printf("Unable to read the table of contents of '%s'.\n", meshFile);
+		return false;
+	}
+
+	// shared by the checksums of all sections and the decoder
+	tf::Executor executor(getNumConversionThreads());
+
+	auto readSection = [f, &checksums, &executor](const MeshFileSection &s, void *dst) -> bool
+	{
+		if (!seekFile(f, s.offset) || fread(dst, 1, s.size, f) != s.size)
+			return false;
+
+		if (!verifySectionChunks(s, dst, checksums, executor))
+		{
+			printf("Checksum mismatch in section %u.\n", s.type);
+			return false;
+		}
+
+		return true;
+	};
+
+	auto readVector = [&readSection](const MeshFileSection &s, auto &v) -> bool
+	{
+		using T = typename std::decay_t<decltype(v)>::value_type;
+
+		if (s.size % sizeof(T))
+			return false;
+
+		v.resize(s.size / sizeof(T));
+
+		return readSection(s, v.data());
+	};
+
+	// the geometry of compressed files is decoded below
+	const MeshFileSection *codecChunks = findSection(sections, MeshFileSection_CodecChunks);
+	const uint32_t readMask = sectionMask & sMeshFileSectionBits_All & (codecChunks ? ~(uint32_t)sMeshFileSectionBits_Geometry : ~0u);
+
+	for (uint32_t type = 0; type != MeshFileSection_Count; type++)
+	{
+		if (!(readMask & (1u << type)))
+			continue;
+
+		const MeshFileSection *s = findSection(sections, type);
+
+		if (!s)
+		{
+			printf("Section %u is missing in '%s'.\n", type, meshFile);
+			return false;
+		}
+
+		bool result = false;
+
+		switch (type)
+		{
+		case MeshFileSection_Streams:
+			result = s->size == sizeof(out.streams) && readSection(*s, &out.streams);
+			break;
+		case MeshFileSection_Meshes:
+			result = readVector(*s, out.meshes);
+			break;
+		case MeshFileSection_Boxes:
+			result = readVector(*s, out.boxes);
+			break;
+		case MeshFileSection_Indices:
+			result = readVector(*s, out.indexData);
+			break;
+		case MeshFileSection_Vertices:
+			result = readVector(*s, out.vertexData);
+			break;
+		case MeshFileSection_Indices16:
+			result = readVector(*s, out.indexData16);
+			break;
+		case MeshFileSection_Meshlets:
+			result = readVector(*s, out.meshlets);
+			break;
+		case MeshFileSection_Spheres:
+			result = readVector(*s, out.spheres);
+			break;
+		case MeshFileSection_OBBs:
+			result = readVector(*s, out.obbs);
+			break;
+		}
+
+		if (!result)
+		{
+			printf("Unable to read section %u of '%s'.\n", type, meshFile);
+			return false;
+		}
+	}
+
+	if (!codecChunks || !(sectionMask & sMeshFileSectionBits_Geometry))
+		return true;
+
+	// all three geometry sections are decoded together
+	const MeshFileSection *streams = findSection(sections, MeshFileSection_Streams);
+	const MeshFileSection *encodedGeometry = findSection(sections, MeshFileSection_EncodedGeometry);
+
+	std::vector<MeshCodecChunk> chunks;
+	std::vector<uint8_t> encoded;
+	CompressedMeshData compressed;
+
+	if (!streams || !encodedGeometry || streams->size != sizeof(compressed.streams) || !readSection(*streams, &compressed.streams) ||
+		!readVector(*codecChunks, chunks) || !readVector(*encodedGeometry, encoded))
+	{
+		printf("Unable to read the encoded geometry of '%s'.\n", meshFile);
+		return false;
+	}
+
+	compressed.chunks = chunks;
+	compressed.encodedData = encoded;
+	setDecodedSizes(compressed);
+
+	out.indexData.resize(compressed.indexDataSize / sizeof(uint32_t));
+	out.indexData16.resize(compressed.indexData16Size / sizeof(uint16_t));
+	out.vertexData.resize(compressed.vertexDataSize);
+
+	if (!decodeMeshData(compressed, out.indexData.data(), out.indexData16.data(), out.vertexData.data(), executor))
+	{
+		printf("Unable to decode mesh file '%s'.\n", meshFile);
+		return false;
+	}
+
+	return true;
+}
+
+void loadMeshData(const char *meshFile, MeshData &out)
 {
 	FILE *f = fopen(meshFile, "rb");
 
@@ -103,6 +634,18 @@ MeshFileHeader loadMeshData(const char *meshFile, MeshData &out)
 		exit(EXIT_FAILURE);
 	}
 
+	if (header.magicValue == kMeshFileMagicV2)
+	{
+		if (!loadMeshDataSections(meshFile, sMeshFileSectionBits_All, out))
+		{
+			printf("Unable to read mesh file '%s'.\n", meshFile);
+			assert(false);
+			exit(EXIT_FAILURE);
+		}
+
+		return;
+	}
+
 	if (fread(&out.streams, 1, sizeof(out.streams), f) != sizeof(out.streams))
 	{
 		printf("Unable to read vertex streams description.\n");
@@ -126,7 +669,18 @@ MeshFileHeader loadMeshData(const char *meshFile, MeshData &out)
 		exit(EXIT_FAILURE);
 	}
 
+	// v1 files have only AABBs
+	out.spheres.clear();
+	out.obbs.clear();
+	for (const BoundingBox &box : out.boxes)
+	{
+		out.spheres.push_back({box.getCenter(), 0.5f * glm::length(box.getSize())});
+		out.obbs.emplace_back(box);
+	}
+
+	out.meshlets.clear();
 	out.indexData.resize(header.indexDataSize / sizeof(uint32_t));
+	out.indexData16.clear();
 	out.vertexData.resize(header.vertexDataSize);
 
 	if (fread(out.indexData.data(), 1, header.indexDataSize, f) != header.indexDataSize)
@@ -142,18 +696,504 @@ MeshFileHeader loadMeshData(const char *meshFile, MeshData &out)
 		assert(false);
 		exit(EXIT_FAILURE);
 	}
+}
 
-	return header;
+MeshDataView::MeshDataView(const MeshData &m)
+	: streams(m.streams), meshes(m.meshes), boxes(m.boxes), spheres(m.spheres), obbs(m.obbs),
+	  meshlets(m.meshlets), indexData(m.indexData), indexData16(m.indexData16), vertexData(m.vertexData)
+{
 }
 
-void loadMeshDataMaterials(const char *fileName, MeshData &out)
+MeshDataView::~MeshDataView()
 {
-	FILE *f = fopen(fileName, "rb");
+	unmap();
+}
 
-	if (!f)
-	{
-		printf("Cannot open '%s'.\n", fileName);
-		assert(false);
+MeshDataView::MeshDataView(MeshDataView &&other) noexcept
+{
+	*this = std::move(other);
+}
+
+MeshDataView &MeshDataView::operator=(MeshDataView &&other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	unmap();
+
+	streams = other.streams;
+	meshes = other.meshes;
+	boxes = other.boxes;
+	spheres = other.spheres;
+	obbs = other.obbs;
+	meshlets = other.meshlets;
+	indexData = other.indexData;
+	indexData16 = other.indexData16;
+	vertexData = other.vertexData;
+	positions = other.positions;
+	shadowIndices = other.shadowIndices;
+	shadowIndices16 = other.shadowIndices16;
+	compressed = other.compressed;
+	isCompressed_ = std::exchange(other.isCompressed_, false);
+	hasDepthGeometry_ = std::exchange(other.hasDepthGeometry_, false);
+	sections_ = std::move(other.sections_);
+	checksums_ = std::exchange(other.checksums_, {});
+	chunkSize_ = std::exchange(other.chunkSize_, 0);
+	chunkVerified_ = std::move(other.chunkVerified_);
+	mappedPtr_ = std::exchange(other.mappedPtr_, nullptr);
+	mappedSize_ = std::exchange(other.mappedSize_, 0);
+#if defined(_WIN32)
+	hFile_ = std::exchange(other.hFile_, nullptr);
+	hMapping_ = std::exchange(other.hMapping_, nullptr);
+#endif
+	other.meshes = {};
+	other.boxes = {};
+	other.spheres = {};
+	other.obbs = {};
+	other.meshlets = {};
+	other.indexData = {};
+	other.indexData16 = {};
+	other.vertexData = {};
+	other.positions = {};
+	other.shadowIndices = {};
+	other.shadowIndices16 = {};
+	other.compressed = {};
+
+	return *this;
+}
+
+void MeshDataView::unmap()
+{
+	if (!mappedPtr_)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(mappedPtr_);
+	CloseHandle((HANDLE)hMapping_);
+	CloseHandle((HANDLE)hFile_);
+	hMapping_ = nullptr;
+	hFile_ = nullptr;
+#else
+	munmap(mappedPtr_, mappedSize_);
+#endif
+
+	mappedPtr_ = nullptr;
+	mappedSize_ = 0;
+	meshes = {};
+	boxes = {};
+	spheres = {};
+	obbs = {};
+	meshlets = {};
+	indexData = {};
+	indexData16 = {};
+	vertexData = {};
+	positions = {};
+	shadowIndices = {};
+	shadowIndices16 = {};
+	compressed = {};
+	isCompressed_ = false;
+	hasDepthGeometry_ = false;
+	sections_ = {};
+	checksums_ = {};
+	chunkSize_ = 0;
+	chunkVerified_.reset();
+}
+
+// only the whole pages inside [data, data + size), the neighbouring sections of the file stay resident
+static size_t evictPages(const void *data, size_t size)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info = {};
+	GetSystemInfo(&info);
+	const uintptr_t pageSize = info.dwPageSize;
+#else
+	const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+#endif
+
+	const uintptr_t begin = ((uintptr_t)data + pageSize - 1) & ~(pageSize - 1);
+	const uintptr_t end = ((uintptr_t)data + size) & ~(pageSize - 1);
+
+	if (!data || end <= begin)
+		return 0;
+
+#if defined(_WIN32)
+	// unlocking pages that are not locked removes them from the working set
+	VirtualUnlock((void *)begin, end - begin);
+#else
+	// the mapping is read-only, so the pages are clean and are simply read from the file again
+	if (madvise((void *)begin, end - begin, MADV_DONTNEED) != 0)
+		return 0;
+#endif
+
+	return end - begin;
+}
+
+size_t MeshDataView::getIndexDataSize() const
+{
+	return isCompressed_ ? compressed.indexDataSize : indexData.size_bytes();
+}
+
+size_t MeshDataView::getIndexData16Size() const
+{
+	return isCompressed_ ? compressed.indexData16Size : indexData16.size_bytes();
+}
+
+size_t MeshDataView::getVertexDataSize() const
+{
+	return isCompressed_ ? compressed.vertexDataSize : vertexData.size_bytes();
+}
+
+bool MeshDataView::verifyChunks(const void *data, size_t size) const
+{
+	if (checksums_.empty() || !size)
+		return true;
+
+	// wraps around for pointers in front of the mapping, which are not inside any section then
+	const uint64_t offset = (uint64_t)((uintptr_t)data - (uintptr_t)mappedPtr_);
+
+	for (const MeshFileSection &s : sections_)
+	{
+		if (offset < s.offset || offset - s.offset > s.size || size > s.size - (offset - s.offset))
+			continue;
+
+		const uint64_t firstChunk = (offset - s.offset) / chunkSize_;
+		const uint64_t lastChunk = (offset - s.offset + size - 1) / chunkSize_;
+
+		for (uint64_t i = firstChunk; i <= lastChunk; i++)
+		{
+			std::atomic<uint8_t> &verified = chunkVerified_[s.firstChunk + i];
+
+			if (verified.load(std::memory_order_relaxed))
+				continue;
+
+			// several threads can hash the same chunk at once, they all come to the same result
+			const uint64_t begin = i * chunkSize_;
+			const uint8_t *chunk = (const uint8_t *)mappedPtr_ + s.offset + begin;
+
+			if (hashBytes(chunk, std::min<uint64_t>(chunkSize_, s.size - begin)) != checksums_[s.firstChunk + i])
+			{
+				printf("Checksum mismatch in chunk %llu of section %u.\n", (unsigned long long)i, s.type);
+				return false;
+			}
+
+			verified.store(1, std::memory_order_relaxed);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool MeshDataView::verifyMeshGeometry(const Mesh &mesh) const
+{
+	if (checksums_.empty())
+		return true;
+
+	const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+	const size_t vertexSize = streams.getVertexSize();
+
+	if (isCompressed_)
+	{
+		const MeshCodecChunk *indexChunk = nullptr;
+		const MeshCodecChunk *vertexChunk = nullptr;
+
+		if (!findMeshChunks(compressed, mesh, indexChunk, vertexChunk))
+			return false;
+
+		for (const MeshCodecChunk *c : {indexChunk, vertexChunk})
+		{
+			if (c && !verifyChunks(compressed.encodedData.data() + c->encodedOffset, c->encodedSize))
+				return false;
+		}
+
+		return true;
+	}
+
+	const void *indices = mesh.isIndex16() ? (const void *)(indexData16.data() + mesh.indexOffset) : (const void *)(indexData.data() + mesh.indexOffset);
+
+	if (!verifyChunks(indices, mesh.lodOffset[mesh.lodCount] * indexSize) ||
+		!verifyChunks(vertexData.data() + (size_t)mesh.vertexOffset * vertexSize, (size_t)mesh.vertexCount * vertexSize))
+		return false;
+
+	if (!hasDepthGeometry_)
+		return true;
+
+	const size_t positionSize = getPositionStream(streams).getVertexSize();
+	const void *depthIndices = mesh.isIndex16() ? (const void *)(shadowIndices16.data() + mesh.indexOffset)
+												: (const void *)(shadowIndices.data() + mesh.indexOffset);
+
+	return verifyChunks(depthIndices, mesh.lodOffset[mesh.lodCount] * indexSize) &&
+		   verifyChunks(positions.data() + (size_t)mesh.vertexOffset * positionSize, (size_t)mesh.vertexCount * positionSize);
+}
+
+size_t MeshDataView::evictGeometry()
+{
+	if (!mappedPtr_)
+		return 0;
+
+	// the spans of the other format are empty
+	return evictPages(indexData.data(), indexData.size_bytes()) + evictPages(indexData16.data(), indexData16.size_bytes()) +
+		   evictPages(vertexData.data(), vertexData.size_bytes()) + evictPages(positions.data(), positions.size_bytes()) +
+		   evictPages(shadowIndices.data(), shadowIndices.size_bytes()) + evictPages(shadowIndices16.data(), shadowIndices16.size_bytes()) +
+		   evictPages(compressed.encodedData.data(), compressed.encodedData.size());
+}
+
+bool loadMeshDataView(const char *meshFile, MeshDataView &out)
+{
+	out.unmap();
+
+	void *ptr = nullptr;
+	size_t fileSize = 0;
+
+#if defined(_WIN32)
+	HANDLE hFile = CreateFileA(meshFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		printf("Cannot open '%s'.\n", meshFile);
+		return false;
+	}
+
+	LARGE_INTEGER size = {};
+	GetFileSizeEx(hFile, &size);
+	fileSize = (size_t)size.QuadPart;
+
+	HANDLE hMapping = fileSize ? CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	ptr = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	if (!ptr)
+	{
+		printf("Cannot map '%s'.\n", meshFile);
+		if (hMapping)
+			CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	out.hFile_ = hFile;
+	out.hMapping_ = hMapping;
+#else
+	const int fd = open(meshFile, O_RDONLY);
+
+	if (fd == -1)
+	{
+		printf("Cannot open '%s'.\n", meshFile);
+		return false;
+	}
+
+	SCOPE_EXIT
+	{
+		// the mapping stays valid after the descriptor is closed
+		close(fd);
+	};
+
+	struct stat st = {};
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		printf("Cannot stat '%s'.\n", meshFile);
+		return false;
+	}
+	fileSize = (size_t)st.st_size;
+
+	ptr = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (ptr == MAP_FAILED)
+	{
+		printf("Cannot map '%s'.\n", meshFile);
+		return false;
+	}
+#endif
+
+	out.mappedPtr_ = ptr;
+	out.mappedSize_ = fileSize;
+
+	const uint8_t *data = (const uint8_t *)ptr;
+
+	MeshFileHeader header;
+
+	if (fileSize < sizeof(header))
+	{
+		printf("Unable to read mesh file header.\n");
+		out.unmap();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+
+	std::vector<MeshFileSection> sections;
+
+	if (header.magicValue == kMeshFileMagic)
+	{
+		sections = getSectionsV1(header);
+	}
+	else if (header.magicValue == kMeshFileMagicV2)
+	{
+		MeshFileHeaderV2 headerV2;
+
+		if (fileSize < sizeof(headerV2))
+		{
+			printf("Mesh file '%s' is truncated.\n", meshFile);
+			out.unmap();
+			return false;
+		}
+
+		memcpy(&headerV2, data, sizeof(headerV2));
+
+		const uint64_t checksumsOffset = sizeof(headerV2) + (uint64_t)headerV2.numSections * sizeof(MeshFileSection);
+
+		if (!headerV2.chunkSize || checksumsOffset + (uint64_t)headerV2.numChunks * sizeof(uint64_t) > fileSize)
+		{
+			printf("Mesh file '%s' is truncated.\n", meshFile);
+			out.unmap();
+			return false;
+		}
+
+		sections.resize(headerV2.numSections);
+		memcpy(sections.data(), data + sizeof(headerV2), sections.size() * sizeof(MeshFileSection));
+
+		for (const MeshFileSection &s : sections)
+		{
+			if (s.firstChunk + getNumChunks(s.size, headerV2.chunkSize) > headerV2.numChunks)
+			{
+				printf("Corrupted table of contents in '%s'.\n", meshFile);
+				out.unmap();
+				return false;
+			}
+		}
+
+		// the sections stay mapped, their chunks are verified on first access (see MeshDataView::verifyChunks())
+		out.sections_ = sections;
+		out.checksums_ = {(const uint64_t *)(data + checksumsOffset), headerV2.numChunks};
+		out.chunkSize_ = headerV2.chunkSize;
+		out.chunkVerified_ = std::make_unique<std::atomic<uint8_t>[]>(headerV2.numChunks);
+	}
+	else
+	{
+		printf("Mesh file '%s' cannot be mapped: unsupported format.\n", meshFile);
+		out.unmap();
+		return false;
+	}
+
+	const MeshFileSection *found[MeshFileSection_Count] = {};
+
+	for (const MeshFileSection &s : sections)
+	{
+		if (s.type < MeshFileSection_Count)
+			found[s.type] = &s;
+	}
+
+	// the encoded geometry of compressed files is mapped as it is and decoded mesh by mesh (see decodeMeshGeometry())
+	const bool isCompressed = found[MeshFileSection_CodecChunks] != nullptr;
+	const uint32_t requiredSections = sMeshFileSectionBits_Metadata | (isCompressed ? sMeshFileSectionBits_Encoded : sMeshFileSectionBits_Geometry);
+
+	for (uint32_t type = 0; type != MeshFileSection_Count; type++)
+	{
+		const MeshFileSection *s = found[type];
+
+		if (!s && !(requiredSections & (1u << type)))
+			continue;
+
+		if (!s || s->offset + s->size < s->offset || s->offset + s->size > fileSize)
+		{
+			printf("Mesh file '%s' is truncated.\n", meshFile);
+			out.unmap();
+			return false;
+		}
+	}
+
+	if (found[MeshFileSection_Streams]->size != sizeof(lvk::VertexInput))
+	{
+		printf("Unable to read vertex streams description.\n");
+		out.unmap();
+		return false;
+	}
+
+	if (isCompressed && found[MeshFileSection_CodecChunks]->size % sizeof(MeshCodecChunk))
+	{
+		printf("Corrupted chunk descriptors in '%s'.\n", meshFile);
+		out.unmap();
+		return false;
+	}
+
+	// the sections a file does not have stay empty
+	auto sectionData = [data, &found](MeshFileSectionType type)
+	{
+		return found[type] ? data + found[type]->offset : nullptr;
+	};
+	auto sectionSize = [&found](MeshFileSectionType type) -> uint64_t
+	{
+		return found[type] ? found[type]->size : 0;
+	};
+
+	memcpy(&out.streams, sectionData(MeshFileSection_Streams), sizeof(lvk::VertexInput));
+
+	out.meshes = {(const Mesh *)sectionData(MeshFileSection_Meshes), sectionSize(MeshFileSection_Meshes) / sizeof(Mesh)};
+	out.boxes = {(const BoundingBox *)sectionData(MeshFileSection_Boxes), sectionSize(MeshFileSection_Boxes) / sizeof(BoundingBox)};
+	out.spheres = {(const BoundingSphere *)sectionData(MeshFileSection_Spheres), sectionSize(MeshFileSection_Spheres) / sizeof(BoundingSphere)};
+	out.obbs = {(const OrientedBoundingBox *)sectionData(MeshFileSection_OBBs), sectionSize(MeshFileSection_OBBs) / sizeof(OrientedBoundingBox)};
+	out.meshlets = {(const Meshlet *)sectionData(MeshFileSection_Meshlets), sectionSize(MeshFileSection_Meshlets) / sizeof(Meshlet)};
+	out.indexData = {(const uint32_t *)sectionData(MeshFileSection_Indices), sectionSize(MeshFileSection_Indices) / sizeof(uint32_t)};
+	out.indexData16 = {(const uint16_t *)sectionData(MeshFileSection_Indices16), sectionSize(MeshFileSection_Indices16) / sizeof(uint16_t)};
+	out.vertexData = {sectionData(MeshFileSection_Vertices), sectionSize(MeshFileSection_Vertices)};
+
+	// the depth-only geometry is optional, all three sections or none
+	if (!isCompressed && found[MeshFileSection_Positions] && found[MeshFileSection_ShadowIndices] && found[MeshFileSection_ShadowIndices16])
+	{
+		out.positions = {sectionData(MeshFileSection_Positions), sectionSize(MeshFileSection_Positions)};
+		out.shadowIndices = {
+			(const uint32_t *)sectionData(MeshFileSection_ShadowIndices), sectionSize(MeshFileSection_ShadowIndices) / sizeof(uint32_t)};
+		out.shadowIndices16 = {
+			(const uint16_t *)sectionData(MeshFileSection_ShadowIndices16), sectionSize(MeshFileSection_ShadowIndices16) / sizeof(uint16_t)};
+		out.hasDepthGeometry_ = true;
+
+		const size_t numVertices = out.vertexData.size() / out.streams.getVertexSize();
+
+		if (out.positions.size() != numVertices * getPositionStream(out.streams).getVertexSize() ||
+			out.shadowIndices.size() != out.indexData.size() || out.shadowIndices16.size() != out.indexData16.size())
+		{
+			printf("Depth-only geometry does not match the geometry in '%s'.\n", meshFile);
+			out.unmap();
+			return false;
+		}
+	}
+
+	if (isCompressed)
+	{
+		out.compressed = {
+			.streams = out.streams,
+			.chunks = {(const MeshCodecChunk *)sectionData(MeshFileSection_CodecChunks), sectionSize(MeshFileSection_CodecChunks) / sizeof(MeshCodecChunk)},
+			.encodedData = {sectionData(MeshFileSection_EncodedGeometry), sectionSize(MeshFileSection_EncodedGeometry)},
+		};
+		setDecodedSizes(out.compressed);
+		out.isCompressed_ = true;
+	}
+
+	// Everything except the geometry is read right away, e.g. by culling. The geometry is verified mesh by mesh when it is uploaded
+	for (uint32_t type = 0; type != MeshFileSection_Count; type++)
+	{
+		if (!((sMeshFileSectionBits_Metadata | sMeshFileSectionBits_CodecChunks) & (1u << type)) || !found[type])
+			continue;
+
+		if (!out.verifyChunks(sectionData((MeshFileSectionType)type), sectionSize((MeshFileSectionType)type)))
+		{
+			printf("Checksum mismatch in section %u of '%s'.\n", type, meshFile);
+			out.unmap();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void loadMeshDataMaterials(const char *fileName, MeshData &out)
+{
+	FILE *f = fopen(fileName, "rb");
+
+	if (!f)
+	{
+		printf("Cannot open '%s'.\n", fileName);
+		assert(false);
 		exit(EXIT_FAILURE);
 	}
 
@@ -189,36 +1229,382 @@ void loadMeshDataMaterials(const char *fileName, MeshData &out)
 		exit(EXIT_FAILURE);
 	}
 
-	loadStringList(f, out.textureFiles);
+	loadStringList(f, out.textureFiles);
+
+	fclose(f);
+}
+
+// one section of a v2 file, see writeMeshFile()
+struct MeshFileSectionData
+{
+	uint32_t type = 0;
+	const void *data = nullptr;
+	uint64_t size = 0;
+};
+
+// writes the v2 container: the header, the table of contents, the checksums of all chunks and the 16-byte aligned sections
+static void writeMeshFile(const char *fileName, std::span<const MeshFileSectionData> data)
+{
+	FILE *f = fopen(fileName, "wb");
+
+	if (!f)
+	{
+		printf("Error opening file '%s' for writing.\n", fileName);
+		assert(false);
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<MeshFileSection> sections(data.size());
+	std::vector<uint64_t> checksums;
+
+	for (size_t i = 0; i != data.size(); i++)
+	{
+		const MeshFileSectionData &d = data[i];
+
+		sections[i] = {
+			.type = d.type,
+			.firstChunk = (uint32_t)checksums.size(),
+			.size = d.size,
+		};
+		for (uint64_t begin = 0; begin < d.size; begin += kMeshFileChunkSize)
+			checksums.push_back(hashBytes((const uint8_t *)d.data + begin, std::min<uint64_t>(kMeshFileChunkSize, d.size - begin)));
+	}
+
+	const uint64_t tocSize = sizeof(MeshFileHeaderV2) + sections.size() * sizeof(MeshFileSection) + checksums.size() * sizeof(uint64_t);
+
+	uint64_t offset = alignSectionOffset(tocSize);
+
+	for (MeshFileSection &s : sections)
+	{
+		s.offset = offset;
+		offset = alignSectionOffset(offset + s.size);
+	}
+
+	const MeshFileHeaderV2 header = {
+		.numSections = (uint32_t)sections.size(),
+		.fileSize = sections.empty() ? tocSize : sections.back().offset + sections.back().size,
+		.numChunks = (uint32_t)checksums.size(),
+	};
+
+	fwrite(&header, 1, sizeof(header), f);
+	fwrite(sections.data(), sizeof(MeshFileSection), sections.size(), f);
+	fwrite(checksums.data(), sizeof(uint64_t), checksums.size(), f);
+
+	uint64_t pos = tocSize;
+
+	for (size_t i = 0; i != data.size(); i++)
+	{
+		const uint8_t padding[16] = {};
+		fwrite(padding, 1, sections[i].offset - pos, f);
+		fwrite(data[i].data, 1, data[i].size, f);
+		pos = sections[i].offset + sections[i].size;
+	}
+
+	fclose(f);
+}
+
+// the position stream and the shadow indices of all meshes, see MeshFileSection_Positions
+static void buildDepthGeometry(
+	const MeshData &m, std::vector<uint8_t> &positions, std::vector<uint32_t> &shadowIndices, std::vector<uint16_t> &shadowIndices16)
+{
+	const uint32_t vertexSize = m.streams.getVertexSize();
+	const uint32_t positionSize = getPositionStream(m.streams).getVertexSize();
+	const uint32_t numVertices = vertexSize ? (uint32_t)(m.vertexData.size() / vertexSize) : 0;
+
+	positions.resize((size_t)numVertices * positionSize);
+	extractPositions(m.streams, m.vertexData.data(), numVertices, positions.data());
+
+	shadowIndices.resize(m.indexData.size());
+	shadowIndices16.resize(m.indexData16.size());
+
+	// every mesh writes only its own index range
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, (uint32_t)m.meshes.size(), 1u, [&](uint32_t i)
+							{
+		const Mesh &mesh = m.meshes[i];
+		const void *indices = mesh.isIndex16() ? (const void *)(m.indexData16.data() + mesh.indexOffset) : (const void *)(m.indexData.data() + mesh.indexOffset);
+		void *dst = mesh.isIndex16() ? (void *)(shadowIndices16.data() + mesh.indexOffset) : (void *)(shadowIndices.data() + mesh.indexOffset);
+
+		generateShadowIndices(mesh, indices, positions.data() + (size_t)mesh.vertexOffset * positionSize, positionSize, dst); });
+
+	tf::Executor executor(getNumConversionThreads());
+	executor.run(taskflow).wait();
+}
+
+void saveMeshData(const char *fileName, const MeshData &m)
+{
+	// isMeshDataValid() rejects files with missing bounding volumes, call recalculateBoundingVolumes() before saving
+	LVK_ASSERT(m.boxes.size() == m.meshes.size() && m.spheres.size() == m.meshes.size() && m.obbs.size() == m.meshes.size());
+
+	// built here, so that the renderer copies them straight from the mapped file
+	std::vector<uint8_t> positions;
+	std::vector<uint32_t> shadowIndices;
+	std::vector<uint16_t> shadowIndices16;
+	buildDepthGeometry(m, positions, shadowIndices, shadowIndices16);
+
+	const MeshFileSectionData sections[] = {
+		{MeshFileSection_Streams, &m.streams, sizeof(m.streams)},
+		{MeshFileSection_Meshes, m.meshes.data(), m.meshes.size() * sizeof(Mesh)},
+		{MeshFileSection_Boxes, m.boxes.data(), m.boxes.size() * sizeof(BoundingBox)},
+		{MeshFileSection_Indices, m.indexData.data(), m.indexData.size() * sizeof(uint32_t)},
+		{MeshFileSection_Vertices, m.vertexData.data(), m.vertexData.size()},
+		{MeshFileSection_Indices16, m.indexData16.data(), m.indexData16.size() * sizeof(uint16_t)},
+		{MeshFileSection_Meshlets, m.meshlets.data(), m.meshlets.size() * sizeof(Meshlet)},
+		{MeshFileSection_Spheres, m.spheres.data(), m.spheres.size() * sizeof(BoundingSphere)},
+		{MeshFileSection_OBBs, m.obbs.data(), m.obbs.size() * sizeof(OrientedBoundingBox)},
+		{MeshFileSection_Positions, positions.data(), positions.size()},
+		{MeshFileSection_ShadowIndices, shadowIndices.data(), shadowIndices.size() * sizeof(uint32_t)},
+		{MeshFileSection_ShadowIndices16, shadowIndices16.data(), shadowIndices16.size() * sizeof(uint16_t)},
+	};
+
+	writeMeshFile(fileName, sections);
+}
+
+// split [0, numElements) into chunks starting at the given offsets
+static std::vector<uint32_t> getChunkBoundaries(std::vector<uint32_t> offsets, uint32_t numElements)
+{
+	offsets.push_back(0);
+	offsets.push_back(numElements);
+
+	std::erase_if(offsets, [numElements](uint32_t o)
+				  { return o > numElements; });
+	std::sort(offsets.begin(), offsets.end());
+	offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+	return offsets;
+}
+
+template <typename T>
+static void encodeIndexChunks(
+	const std::vector<T> &indexData, const std::vector<uint32_t> &offsets, uint32_t flags, std::vector<MeshCodecChunk> &chunks,
+	std::vector<uint8_t> &encoded)
+{
+	const std::vector<uint32_t> bounds = getChunkBoundaries(offsets, (uint32_t)indexData.size());
+
+	for (size_t i = 0; i + 1 < bounds.size(); i++)
+	{
+		const uint32_t first = bounds[i];
+		const uint32_t count = bounds[i + 1] - first;
+		const T *indices = indexData.data() + first;
+		const uint32_t numChunkVertices = (uint32_t)*std::max_element(indices, indices + count) + 1;
+
+		// the triangle codec compresses better, but can rotate the vertices of a triangle (the winding order is preserved)
+		const bool isTriangleList = count % 3 == 0;
+
+		const size_t pos = encoded.size();
+
+		if (isTriangleList)
+		{
+			encoded.resize(pos + meshopt_encodeIndexBufferBound(count, numChunkVertices));
+			encoded.resize(pos + meshopt_encodeIndexBuffer(encoded.data() + pos, encoded.size() - pos, indices, count));
+		}
+		else
+		{
+			encoded.resize(pos + meshopt_encodeIndexSequenceBound(count, numChunkVertices));
+			encoded.resize(pos + meshopt_encodeIndexSequence(encoded.data() + pos, encoded.size() - pos, indices, count));
+		}
+
+		chunks.push_back({
+			.flags = flags | (isTriangleList ? 0u : (uint32_t)sMeshCodecChunk_IndexSequence),
+			.firstElement = first,
+			.numElements = count,
+			.encodedOffset = pos,
+			.encodedSize = encoded.size() - pos,
+		});
+	}
+}
+
+void saveMeshDataCompressed(const char *fileName, const MeshData &m)
+{
+	LVK_ASSERT(m.boxes.size() == m.meshes.size() && m.spheres.size() == m.meshes.size() && m.obbs.size() == m.meshes.size());
+
+	const uint32_t vertexSize = m.streams.getVertexSize();
+
+	// meshoptimizer's vertex codec requirements
+	LVK_ASSERT(vertexSize % 4 == 0 && vertexSize <= 256);
+
+	const uint32_t numVertices = vertexSize ? (uint32_t)(m.vertexData.size() / vertexSize) : 0;
+
+	std::vector<uint32_t> indexOffsets;
+	std::vector<uint32_t> indexOffsets16;
+	std::vector<uint32_t> vertexOffsets;
+	indexOffsets.reserve(m.meshes.size());
+	vertexOffsets.reserve(m.meshes.size());
+
+	for (const Mesh &mesh : m.meshes)
+	{
+		(mesh.isIndex16() ? indexOffsets16 : indexOffsets).push_back(mesh.indexOffset);
+		vertexOffsets.push_back(mesh.vertexOffset);
+	}
+
+	std::vector<MeshCodecChunk> chunks;
+	std::vector<uint8_t> encoded;
+
+	encodeIndexChunks(m.indexData, indexOffsets, sMeshCodecChunk_Index, chunks, encoded);
+	encodeIndexChunks(m.indexData16, indexOffsets16, sMeshCodecChunk_Index | sMeshCodecChunk_Index16, chunks, encoded);
+
+	const std::vector<uint32_t> vertexBounds = getChunkBoundaries(vertexOffsets, numVertices);
+
+	for (size_t i = 0; i + 1 < vertexBounds.size(); i++)
+	{
+		const uint32_t first = vertexBounds[i];
+		const uint32_t count = vertexBounds[i + 1] - first;
+
+		const size_t pos = encoded.size();
+
+		encoded.resize(pos + meshopt_encodeVertexBufferBound(count, vertexSize));
+		encoded.resize(
+			pos + meshopt_encodeVertexBuffer(
+					  encoded.data() + pos, encoded.size() - pos, m.vertexData.data() + (size_t)first * vertexSize, count, vertexSize));
+
+		chunks.push_back({
+			.flags = sMeshCodecChunk_Vertex,
+			.firstElement = first,
+			.numElements = count,
+			.encodedOffset = pos,
+			.encodedSize = encoded.size() - pos,
+		});
+	}
+
+	// the same container as saveMeshData(), the encoded sections replace the index and vertex sections
+	const MeshFileSectionData sections[] = {
+		{MeshFileSection_Streams, &m.streams, sizeof(m.streams)},
+		{MeshFileSection_Meshes, m.meshes.data(), m.meshes.size() * sizeof(Mesh)},
+		{MeshFileSection_Boxes, m.boxes.data(), m.boxes.size() * sizeof(BoundingBox)},
+		{MeshFileSection_Meshlets, m.meshlets.data(), m.meshlets.size() * sizeof(Meshlet)},
+		{MeshFileSection_Spheres, m.spheres.data(), m.spheres.size() * sizeof(BoundingSphere)},
+		{MeshFileSection_OBBs, m.obbs.data(), m.obbs.size() * sizeof(OrientedBoundingBox)},
+		{MeshFileSection_CodecChunks, chunks.data(), chunks.size() * sizeof(MeshCodecChunk)},
+		{MeshFileSection_EncodedGeometry, encoded.data(), encoded.size()},
+	};
+
+	writeMeshFile(fileName, sections);
+
+	printf(
+		"Compressed mesh data: %zu -> %zu bytes in %zu chunks\n",
+		m.indexData.size() * sizeof(uint32_t) + m.indexData16.size() * sizeof(uint16_t) + m.vertexData.size(), encoded.size(), chunks.size());
+}
+
+bool decodeMeshData(
+	const CompressedMeshData &data, uint32_t *dstIndices, uint16_t *dstIndices16, uint8_t *dstVertices, tf::Executor &executor)
+{
+	const uint32_t vertexSize = data.streams.getVertexSize();
+	const uint64_t numIndices = data.indexDataSize / sizeof(uint32_t);
+	const uint64_t numIndices16 = data.indexData16Size / sizeof(uint16_t);
+	const uint64_t numVertices = vertexSize ? data.vertexDataSize / vertexSize : 0;
+
+	// make sure no chunk can write outside of the destination buffers
+	for (const MeshCodecChunk &c : data.chunks)
+	{
+		const uint64_t maxElements = (c.flags & sMeshCodecChunk_Vertex) ? numVertices : (c.flags & sMeshCodecChunk_Index16) ? numIndices16 : numIndices;
+
+		if ((uint64_t)c.firstElement + c.numElements > maxElements || c.encodedOffset > data.encodedData.size() ||
+			c.encodedSize > data.encodedData.size() - c.encodedOffset)
+		{
+			printf("Corrupted chunk descriptor.\n");
+			return false;
+		}
+	}
+
+	std::atomic<bool> success = true;
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, static_cast<uint32_t>(data.chunks.size()), 1u, [&](int i)
+							{
+		const MeshCodecChunk &c = data.chunks[i];
+		const uint8_t *src = data.encodedData.data() + c.encodedOffset;
+
+		const bool isIndex16 = (c.flags & sMeshCodecChunk_Index16) != 0;
+		void *dst = isIndex16 ? (void *)(dstIndices16 + c.firstElement) : (void *)(dstIndices + c.firstElement);
+		const size_t indexSize = isIndex16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		int result = 0;
+
+		if (c.flags & sMeshCodecChunk_Vertex)
+			result = meshopt_decodeVertexBuffer(dstVertices + (size_t)c.firstElement * vertexSize, c.numElements, vertexSize, src, c.encodedSize);
+		else if (c.flags & sMeshCodecChunk_IndexSequence)
+			result = meshopt_decodeIndexSequence(dst, c.numElements, indexSize, src, c.encodedSize);
+		else
+			result = meshopt_decodeIndexBuffer(dst, c.numElements, indexSize, src, c.encodedSize);
+
+		if (result != 0)
+			success = false; });
+
+	executor.run(taskflow).wait();
+
+	return success;
+}
+
+static bool decodeMeshChunks(
+	const CompressedMeshData &data, const MeshCodecChunk *indexChunk, const MeshCodecChunk *vertexChunk, size_t indexSize, void *indices,
+	uint8_t *vertices)
+{
+	if (indexChunk)
+	{
+		const uint8_t *src = data.encodedData.data() + indexChunk->encodedOffset;
+		const int result = (indexChunk->flags & sMeshCodecChunk_IndexSequence)
+							   ? meshopt_decodeIndexSequence(indices, indexChunk->numElements, indexSize, src, indexChunk->encodedSize)
+							   : meshopt_decodeIndexBuffer(indices, indexChunk->numElements, indexSize, src, indexChunk->encodedSize);
+		if (result != 0)
+			return false;
+	}
+
+	if (vertexChunk &&
+		meshopt_decodeVertexBuffer(
+			vertices, vertexChunk->numElements, data.streams.getVertexSize(), data.encodedData.data() + vertexChunk->encodedOffset,
+			vertexChunk->encodedSize) != 0)
+		return false;
+
+	return true;
+}
+
+bool decodeMeshGeometry(const CompressedMeshData &data, const Mesh &mesh, std::vector<uint8_t> &indices, std::vector<uint8_t> &vertices)
+{
+	const uint32_t vertexSize = data.streams.getVertexSize();
+
+	const MeshCodecChunk *indexChunk = nullptr;
+	const MeshCodecChunk *vertexChunk = nullptr;
+
+	if (!findMeshChunks(data, mesh, indexChunk, vertexChunk))
+		return false;
+
+	const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
 
-	fclose(f);
+	indices.resize(indexChunk ? (size_t)indexChunk->numElements * indexSize : 0);
+	vertices.resize(vertexChunk ? (size_t)vertexChunk->numElements * vertexSize : 0);
+
+	return decodeMeshChunks(data, indexChunk, vertexChunk, indexSize, indices.data(), vertices.data());
 }
 
-void saveMeshData(const char *fileName, const MeshData &m)
+bool decodeMeshGeometry(const CompressedMeshData &data, const Mesh &mesh, void *indices, uint8_t *vertices)
 {
-	FILE *f = fopen(fileName, "wb");
+	const MeshCodecChunk *indexChunk = nullptr;
+	const MeshCodecChunk *vertexChunk = nullptr;
 
-	if (!f)
+	if (!findMeshChunks(data, mesh, indexChunk, vertexChunk))
+		return false;
+
+	const uint32_t numIndices = mesh.lodOffset[mesh.lodCount];
+	const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	// a chunk ends where the next mesh starts, the unused elements after the mesh do not fit into the destination
+	if ((indexChunk && indexChunk->numElements != numIndices) || (vertexChunk && vertexChunk->numElements != mesh.vertexCount))
 	{
-		printf("Error opening file '%s' for writing.\n", fileName);
-		assert(false);
-		exit(EXIT_FAILURE);
-	}
+		std::vector<uint8_t> decodedIndices;
+		std::vector<uint8_t> decodedVertices;
 
-	const MeshFileHeader header = {
-		.meshCount = (uint32_t)m.meshes.size(),
-		.indexDataSize = (uint32_t)(m.indexData.size() * sizeof(uint32_t)),
-		.vertexDataSize = (uint32_t)(m.vertexData.size()),
-	};
+		if (!decodeMeshGeometry(data, mesh, decodedIndices, decodedVertices))
+			return false;
 
-	fwrite(&header, 1, sizeof(header), f);
-	fwrite(&m.streams, 1, sizeof(m.streams), f);
-	fwrite(m.meshes.data(), sizeof(Mesh), header.meshCount, f);
-	fwrite(m.boxes.data(), sizeof(BoundingBox), header.meshCount, f);
-	fwrite(m.indexData.data(), 1, header.indexDataSize, f);
-	fwrite(m.vertexData.data(), 1, header.vertexDataSize, f);
+		memcpy(indices, decodedIndices.data(), numIndices * indexSize);
+		memcpy(vertices, decodedVertices.data(), (size_t)mesh.vertexCount * data.streams.getVertexSize());
 
-	fclose(f);
+		return true;
+	}
+
+	return decodeMeshChunks(data, indexChunk, vertexChunk, indexSize, indices, vertices);
 }
 
 void saveMeshDataMaterials(const char *fileName, const MeshData &m)
@@ -284,10 +1670,11 @@ void loadBoundingBoxes(const char *fileName, std::vector<BoundingBox> &boxes)
 }
 
 // combine a collection of meshes into a single MeshData container
-MeshFileHeader mergeMeshData(MeshData &m, const std::vector<MeshData *> md)
+void mergeMeshData(MeshData &m, const std::vector<MeshData *> md, const std::vector<uint32_t> &materialRemap)
 {
 	uint32_t numTotalVertices = 0;
 	uint32_t numTotalIndices = 0;
+	uint32_t numTotalIndices16 = 0;
 
 	if (!md.empty())
 	{
@@ -298,69 +1685,730 @@ MeshFileHeader mergeMeshData(MeshData &m, const std::vector<MeshData *> md)
 
 	uint32_t offset = 0;
 	uint32_t mtlOffset = 0;
+	uint32_t meshletOffset = 0;
 
 	for (const MeshData *i : md)
 	{
 		LVK_ASSERT(m.streams == i->streams);
 		mergeVectors(m.indexData, i->indexData);
+		mergeVectors(m.indexData16, i->indexData16);
 		mergeVectors(m.vertexData, i->vertexData);
 		mergeVectors(m.meshes, i->meshes);
 		mergeVectors(m.boxes, i->boxes);
+		mergeVectors(m.spheres, i->spheres);
+		mergeVectors(m.obbs, i->obbs);
+		mergeVectors(m.meshlets, i->meshlets);
 
 		for (size_t j = 0; j != i->meshes.size(); j++)
 		{
+			Mesh &mesh = m.meshes[offset + j];
 			// m.vertexCount, m.lodCount and m.streamCount do not change
-			// m.vertexOffset also does not change, because vertex offsets are local (i.e., baked into the indices)
-			m.meshes[offset + j].indexOffset += numTotalIndices;
-			m.meshes[offset + j].materialID += mtlOffset;
-		}
-
-		// shift individual indices
-		for (size_t j = 0; j != i->indexData.size(); j++)
-		{
-			m.indexData[numTotalIndices + j] += numTotalVertices;
+			// the indices are not touched (16-bit indices could overflow), shift the base vertex instead
+			mesh.indexOffset += mesh.isIndex16() ? numTotalIndices16 : numTotalIndices;
+			mesh.vertexOffset += numTotalVertices;
+			mesh.materialID += mtlOffset;
+			if (!materialRemap.empty())
+				mesh.materialID = materialRemap[mesh.materialID];
+			// meshlets are relative to indexOffset and stay valid
+			mesh.meshletOffset += meshletOffset;
 		}
 
 		offset += (uint32_t)i->meshes.size();
 		mtlOffset += (uint32_t)i->materials.size();
+		meshletOffset += (uint32_t)i->meshlets.size();
 
 		numTotalIndices += (uint32_t)i->indexData.size();
+		numTotalIndices16 += (uint32_t)i->indexData16.size();
 		numTotalVertices += (uint32_t)i->vertexData.size() / vertexSize;
 	}
+}
+
+// min/max of Float3 positions at the beginning of every vertex
+static void getPositionBoundsFloat3(const uint8_t *data, uint32_t stride, uint32_t numVertices, vec3 &outMin, vec3 &outMax)
+{
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	// an unaligned 16-byte load reads one attribute past the position, which stays inside the vertex
+	if (stride >= 4 * sizeof(float) && numVertices)
+	{
+		__m128 vmin = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 vmax = _mm_set1_ps(std::numeric_limits<float>::lowest());
+
+		for (uint32_t i = 0; i != numVertices; i++)
+		{
+			const __m128 p = _mm_loadu_ps((const float *)(data + (size_t)i * stride));
+			vmin = _mm_min_ps(vmin, p);
+			vmax = _mm_max_ps(vmax, p);
+		}
+
+		alignas(16) float fmin[4];
+		alignas(16) float fmax[4];
+		_mm_store_ps(fmin, vmin);
+		_mm_store_ps(fmax, vmax);
+
+		outMin = vec3(fmin[0], fmin[1], fmin[2]);
+		outMax = vec3(fmax[0], fmax[1], fmax[2]);
+
+		return;
+	}
+#endif
 
-	return MeshFileHeader{
-		.magicValue = 0x12345678,
-		.meshCount = (uint32_t)offset,
-		.indexDataSize = static_cast<uint32_t>(numTotalIndices * sizeof(uint32_t)),
-		.vertexDataSize = static_cast<uint32_t>(m.vertexData.size()),
+	outMin = vec3(std::numeric_limits<float>::max());
+	outMax = vec3(std::numeric_limits<float>::lowest());
+
+	for (uint32_t i = 0; i != numVertices; i++)
+	{
+		float f[3];
+		memcpy(f, data + (size_t)i * stride, sizeof(f));
+		outMin = glm::min(outMin, vec3(f[0], f[1], f[2]));
+		outMax = glm::max(outMax, vec3(f[0], f[1], f[2]));
+	}
+}
+
+// min/max of UShort4Norm positions, dequantized with the mesh's posScale and posOffset (the dequantization is monotonic)
+static void getPositionBoundsQuantized(const Mesh &mesh, const uint8_t *data, uint32_t stride, uint32_t numVertices, vec3 &outMin, vec3 &outMax)
+{
+	uint16_t qmin[3] = {0xFFFF, 0xFFFF, 0xFFFF};
+	uint16_t qmax[3] = {0, 0, 0};
+
+	for (uint32_t i = 0; i != numVertices; i++)
+	{
+		uint16_t q[3];
+		memcpy(q, data + (size_t)i * stride, sizeof(q));
+
+		for (int c = 0; c != 3; c++)
+		{
+			qmin[c] = std::min(qmin[c], q[c]);
+			qmax[c] = std::max(qmax[c], q[c]);
+		}
+	}
+
+	if (!numVertices)
+	{
+		outMin = vec3(std::numeric_limits<float>::max());
+		outMax = vec3(std::numeric_limits<float>::lowest());
+		return;
+	}
+
+	const vec3 scale(mesh.posScale[0], mesh.posScale[1], mesh.posScale[2]);
+	const vec3 offset(mesh.posOffset[0], mesh.posOffset[1], mesh.posOffset[2]);
+
+	outMin = vec3(qmin[0], qmin[1], qmin[2]) / 65535.0f * scale + offset;
+	outMax = vec3(qmax[0], qmax[1], qmax[2]) / 65535.0f * scale + offset;
+}
+
+// Ritter's sphere, replaced by the sphere around the box center if that one is smaller
+static BoundingSphere getBoundingSphere(const std::vector<vec3> &points, const BoundingBox &box)
+{
+	if (points.empty())
+		return {};
+
+	auto farthestFrom = [&points](const vec3 &p)
+	{
+		return *std::max_element(points.begin(), points.end(), [&p](const vec3 &a, const vec3 &b)
+								 { return glm::dot(a - p, a - p) < glm::dot(b - p, b - p); });
 	};
+
+	const vec3 p1 = farthestFrom(points[0]);
+	const vec3 p2 = farthestFrom(p1);
+
+	vec3 center = 0.5f * (p1 + p2);
+	float radius = 0.5f * glm::distance(p1, p2);
+
+	for (const vec3 &p : points)
+	{
+		const float d = glm::distance(p, center);
+
+		if (d > radius)
+		{
+			const float newRadius = 0.5f * (radius + d);
+			center += (d - newRadius) / d * (p - center);
+			radius = newRadius;
+		}
+	}
+
+	float boxRadius = 0.0f;
+
+	for (const vec3 &p : points)
+		boxRadius = std::max(boxRadius, glm::distance(p, box.getCenter()));
+
+	return boxRadius < radius ? BoundingSphere{box.getCenter(), boxRadius} : BoundingSphere{center, radius};
+}
+
+// Jacobi rotations; the columns of the result are the eigenvectors of the symmetric matrix
+static glm::mat3 getEigenvectors(glm::mat3 a)
+{
+	glm::mat3 v(1.0f);
+
+	for (int iter = 0; iter != 32; iter++)
+	{
+		// the largest off-diagonal element
+		int p = 0;
+		int q = 1;
+		if (fabsf(a[2][0]) > fabsf(a[q][p]))
+		{
+			p = 0;
+			q = 2;
+		}
+		if (fabsf(a[2][1]) > fabsf(a[q][p]))
+		{
+			p = 1;
+			q = 2;
+		}
+
+		if (fabsf(a[q][p]) < 1e-12f)
+			break;
+
+		const float theta = (a[q][q] - a[p][p]) / (2.0f * a[q][p]);
+		const float t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+		const float c = 1.0f / sqrtf(t * t + 1.0f);
+
+		glm::mat3 rot(1.0f);
+		rot[p][p] = c;
+		rot[q][q] = c;
+		rot[q][p] = t * c;
+		rot[p][q] = -t * c;
+
+		a = glm::transpose(rot) * a * rot;
+		v = v * rot;
+	}
+
+	return v;
+}
+
+// principal axes of the points, or the axes of the AABB if they give a smaller volume
+static OrientedBoundingBox getOrientedBoundingBox(const std::vector<vec3> &points, const BoundingBox &box)
+{
+	const OrientedBoundingBox aabb(box);
+
+	if (points.size() < 4)
+		return aabb;
+
+	vec3 mean(0.0f);
+	for (const vec3 &p : points)
+		mean += p;
+	mean /= (float)points.size();
+
+	glm::mat3 cov(0.0f);
+	for (const vec3 &p : points)
+	{
+		const vec3 d = p - mean;
+		cov += glm::outerProduct(d, d);
+	}
+
+	const glm::mat3 axes = getEigenvectors(cov);
+
+	vec3 vmin(std::numeric_limits<float>::max());
+	vec3 vmax(std::numeric_limits<float>::lowest());
+
+	for (const vec3 &p : points)
+	{
+		const vec3 local = glm::transpose(axes) * (p - mean);
+		vmin = glm::min(vmin, local);
+		vmax = glm::max(vmax, local);
+	}
+
+	OrientedBoundingBox obb;
+	obb.center = mean + axes * (0.5f * (vmin + vmax));
+	for (int i = 0; i != 3; i++)
+		obb.axes[i] = axes[i] * (0.5f * (vmax[i] - vmin[i]));
+
+	return obb.getVolume() < aabb.getVolume() ? obb : aabb;
 }
 
 void recalculateBoundingBoxes(MeshData &m)
 {
-	LVK_ASSERT(m.streams.attributes[0].format == lvk::VertexFormat::Float3);
+	const lvk::VertexInput::VertexAttribute &pos = m.streams.attributes[0];
+
+	LVK_ASSERT(pos.offset == 0 && (pos.format == lvk::VertexFormat::Float3 || pos.format == lvk::VertexFormat::UShort4Norm));
 
 	const uint32_t stride = m.streams.getVertexSize();
 
-	m.boxes.clear();
-	m.boxes.reserve(m.meshes.size());
+	m.boxes.resize(m.meshes.size());
+	// no longer match the boxes, see recalculateBoundingVolumes()
+	m.spheres.clear();
+	m.obbs.clear();
 
-	for (const Mesh &mesh : m.meshes)
+	// every mesh owns the contiguous vertex range [vertexOffset, vertexOffset + vertexCount), so each vertex is read exactly once
+	tf::Executor executor(getNumConversionThreads());
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, static_cast<uint32_t>(m.meshes.size()), 1u, [&m, &pos, stride](int i)
+							{
+		const Mesh &mesh = m.meshes[i];
+		const uint8_t *data = m.vertexData.data() + (size_t)mesh.vertexOffset * stride;
+
+		LVK_ASSERT((size_t)(mesh.vertexOffset + mesh.vertexCount) * stride <= m.vertexData.size());
+
+		vec3 vmin;
+		vec3 vmax;
+
+		if (pos.format == lvk::VertexFormat::UShort4Norm)
+			getPositionBoundsQuantized(mesh, data, stride, mesh.vertexCount, vmin, vmax);
+		else
+			getPositionBoundsFloat3(data, stride, mesh.vertexCount, vmin, vmax);
+
+		m.boxes[i] = BoundingBox(vmin, vmax); });
+
+	executor.run(taskflow).wait();
+}
+
+// the positions of a mesh, dequantized if needed
+static void getMeshPositions(const MeshData &m, const Mesh &mesh, std::vector<vec3> &positions)
+{
+	const uint32_t stride = m.streams.getVertexSize();
+	const uint8_t *data = m.vertexData.data() + (size_t)mesh.vertexOffset * stride;
+
+	positions.resize(mesh.vertexCount);
+
+	if (m.streams.attributes[0].format == lvk::VertexFormat::UShort4Norm)
+	{
+		const vec3 scale = vec3(mesh.posScale[0], mesh.posScale[1], mesh.posScale[2]) / 65535.0f;
+		const vec3 offset(mesh.posOffset[0], mesh.posOffset[1], mesh.posOffset[2]);
+
+		for (uint32_t v = 0; v != mesh.vertexCount; v++)
+		{
+			uint16_t q[3];
+			memcpy(q, data + (size_t)v * stride, sizeof(q));
+			positions[v] = vec3(q[0], q[1], q[2]) * scale + offset;
+		}
+		return;
+	}
+
+	for (uint32_t v = 0; v != mesh.vertexCount; v++)
+		memcpy(&positions[v], data + (size_t)v * stride, sizeof(vec3));
+}
+
+void recalculateBoundingVolumes(MeshData &m)
+{
+	LVK_ASSERT(m.boxes.size() == m.meshes.size());
+
+	m.spheres.resize(m.meshes.size());
+	m.obbs.resize(m.meshes.size());
+
+	tf::Executor executor(getNumConversionThreads());
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, static_cast<uint32_t>(m.meshes.size()), 1u, [&m](int i)
+							{
+		// the sphere and the OBB need a few passes over the positions
+		std::vector<vec3> positions;
+		getMeshPositions(m, m.meshes[i], positions);
+
+		m.spheres[i] = getBoundingSphere(positions, m.boxes[i]);
+		m.obbs[i] = getOrientedBoundingBox(positions, m.boxes[i]); });
+
+	executor.run(taskflow).wait();
+}
+
+void generateMeshlets(MeshData &m, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	m.meshlets.clear();
+
+	std::vector<uint32_t> indices;
+	std::vector<float> positions;
+	std::vector<meshopt_Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+
+	uint32_t numTotalTriangles = 0;
+
+	for (Mesh &mesh : m.meshes)
 	{
 		const uint32_t numIndices = mesh.getLODIndicesCount(0);
 
-		glm::vec3 vmin(std::numeric_limits<float>::max());
-		glm::vec3 vmax(std::numeric_limits<float>::lowest());
+		mesh.meshletOffset = (uint32_t)m.meshlets.size();
+		mesh.meshletCount = 0;
+
+		if (numIndices < 3 || numIndices % 3)
+			continue;
+
+		indices.resize(numIndices);
 
 		for (uint32_t i = 0; i != numIndices; i++)
+			indices[i] = getMeshIndex(m, mesh, mesh.lodOffset[0] + i);
+
+		// indices are relative to vertexOffset
+		const uint32_t numVertices = *std::max_element(indices.begin(), indices.end()) + 1;
+
+		positions.resize(numVertices * 3);
+
+		for (uint32_t v = 0; v != numVertices; v++)
+		{
+			const vec3 p = getVertexPosition(m, mesh, mesh.vertexOffset + v);
+			memcpy(&positions[v * 3], &p, sizeof(p));
+		}
+
+		const size_t maxMeshlets = meshopt_buildMeshletsBound(numIndices, maxVertices, maxTriangles);
+
+		meshlets.resize(maxMeshlets);
+		meshletVertices.resize(maxMeshlets * maxVertices);
+		meshletTriangles.resize(maxMeshlets * maxTriangles * 3);
+
+		const size_t numMeshlets = meshopt_buildMeshlets(
+			meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices.data(), numIndices, positions.data(), numVertices,
+			sizeof(float) * 3, maxVertices, maxTriangles, 0.25f);
+
+		// rewrite the LOD0 indices in meshlet order, the number of triangles does not change
+		uint32_t idx = mesh.lodOffset[0];
+
+		for (size_t i = 0; i != numMeshlets; i++)
+		{
+			const meshopt_Meshlet &ml = meshlets[i];
+			const meshopt_Bounds b = meshopt_computeMeshletBounds(
+				&meshletVertices[ml.vertex_offset], &meshletTriangles[ml.triangle_offset], ml.triangle_count, positions.data(), numVertices,
+				sizeof(float) * 3);
+
+			Meshlet meshlet = {
+				.indexOffset = idx,
+				.indexCount = ml.triangle_count * 3,
+				.radius = b.radius,
+				.coneCutoff = b.cone_cutoff,
+			};
+			memcpy(meshlet.center, b.center, sizeof(meshlet.center));
+			memcpy(meshlet.coneApex, b.cone_apex, sizeof(meshlet.coneApex));
+			memcpy(meshlet.coneAxis, b.cone_axis, sizeof(meshlet.coneAxis));
+
+			for (uint32_t t = 0; t != meshlet.indexCount; t++, idx++)
+			{
+				const uint32_t index = meshletVertices[ml.vertex_offset + meshletTriangles[ml.triangle_offset + t]];
+
+				if (mesh.isIndex16())
+					m.indexData16[mesh.indexOffset + idx] = (uint16_t)index;
+				else
+					m.indexData[mesh.indexOffset + idx] = index;
+			}
+
+			m.meshlets.push_back(meshlet);
+		}
+
+		LVK_ASSERT(idx == mesh.lodOffset[0] + numIndices);
+
+		mesh.meshletCount = (uint32_t)numMeshlets;
+		numTotalTriangles += numIndices / 3;
+	}
+
+	printf(
+		"Meshlets: %u meshlets, %.1f triangles per meshlet\n", (uint32_t)m.meshlets.size(),
+		m.meshlets.empty() ? 0.0f : (float)numTotalTriangles / m.meshlets.size());
+}
+
+void optimizeMeshGeometry(std::vector<uint32_t> &indices, std::vector<uint8_t> &vertices, size_t vertexStride)
+{
+	const size_t vertexCountIn = vertices.size() / vertexStride;
+	std::vector<uint32_t> remap(vertexCountIn);
+	const size_t vertexCountOut =
+		meshopt_generateVertexRemap(remap.data(), indices.data(), indices.size(), vertices.data(), vertexCountIn, vertexStride);
+
+	std::vector<uint32_t> remappedIndices(indices.size());
+	std::vector<uint8_t> remappedVertices(vertexCountOut * vertexStride);
+
+	meshopt_remapIndexBuffer(remappedIndices.data(), indices.data(), indices.size(), remap.data());
+	meshopt_remapVertexBuffer(remappedVertices.data(), vertices.data(), vertexCountIn, vertexStride, remap.data());
+
+	meshopt_optimizeVertexCache(remappedIndices.data(), remappedIndices.data(), indices.size(), vertexCountOut);
+	meshopt_optimizeOverdraw(
+		remappedIndices.data(), remappedIndices.data(), indices.size(), (const float *)remappedVertices.data(), vertexCountOut,
+		vertexStride, 1.05f);
+	meshopt_optimizeVertexFetch(
+		remappedVertices.data(), remappedIndices.data(), indices.size(), remappedVertices.data(), vertexCountOut, vertexStride);
+
+	indices = std::move(remappedIndices);
+	vertices = std::move(remappedVertices);
+}
+
+// LOD sizes are not printed here because meshes are converted in parallel, see loadMeshFile() in SceneUtils.h.
+// Every LOD is simplified from the previous one with attribute-aware simplification: UV and normal seams are kept because the
+// vertices on both sides of a seam are distinct, and the mesh borders are locked so that neighbouring meshes do not crack apart.
+// The chain stops as soon as a LOD cannot be simplified enough, there is no sloppy fallback that would tear the surface.
+// outLodErrors receives the mesh-space simplification error of every LOD, the errors of the chain add up
+void processLODs(
+	std::vector<uint32_t> &indices, std::vector<uint8_t> &vertices, size_t vertexStride, std::vector<std::vector<uint32_t>> &outLods,
+	std::vector<float> &outLodErrors, bool generateLods)
+{
+	size_t verticesCountIn = vertices.size() / vertexStride;
+	size_t targetIndicesCount = indices.size();
+
+	outLods.push_back(indices);
+	outLodErrors.push_back(0.0f);
+
+	if (!generateLods)
+		return;
+
+	// the vertex layout is described by getAIMeshVertexStreams(): pos (float3), uv (half2), normal (2_10_10_10_REV)
+	constexpr size_t kNumAttributes = 5;
+	constexpr float kAttributeWeights[kNumAttributes] = {0.5f, 0.5f, 0.5f, 1.0f, 1.0f}; // normal, uv
+	constexpr float kTargetError = 0.02f;
+	constexpr float kMinReduction = 0.9f; // every LOD should have at most 90% of the previous indices
+
+	std::vector<float> attributes(verticesCountIn * kNumAttributes);
+
+	for (size_t i = 0; i != verticesCountIn; i++)
+	{
+		const uint8_t *v = vertices.data() + i * vertexStride;
+		const vec2 uv = glm::unpackHalf2x16(*(const uint32_t *)(v + sizeof(vec3)));
+		const vec4 n = glm::unpackSnorm3x10_1x2(*(const uint32_t *)(v + sizeof(vec3) + sizeof(uint32_t)));
+		float *a = attributes.data() + i * kNumAttributes;
+		a[0] = n.x;
+		a[1] = n.y;
+		a[2] = n.z;
+		a[3] = uv.x;
+		a[4] = uv.y;
+	}
+
+	// meshoptimizer reports errors relative to the mesh extents
+	const float errorScale = meshopt_simplifyScale((const float *)vertices.data(), verticesCountIn, vertexStride);
+
+	std::vector<uint32_t> lod(indices.size());
+
+	uint8_t LOD = 1;
+
+	while (targetIndicesCount > 1024 && LOD < kMaxLODs)
+	{
+		targetIndicesCount /= 2;
+
+		float error = 0.0f;
+
+		const size_t numOptIndices = meshopt_simplifyWithAttributes(
+			lod.data(), indices.data(), indices.size(), (const float *)vertices.data(), verticesCountIn, vertexStride, attributes.data(),
+			kNumAttributes * sizeof(float), kAttributeWeights, kNumAttributes, nullptr, targetIndicesCount, kTargetError,
+			meshopt_SimplifyLockBorder, &error);
+
+		// cannot simplify further without breaking the borders or the seams
+		if (numOptIndices == 0 || numOptIndices > static_cast<size_t>(indices.size() * kMinReduction))
+			break;
+
+		indices.assign(lod.begin(), lod.begin() + numOptIndices);
+
+		meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), verticesCountIn);
+
+		LOD++;
+
+		outLods.push_back(indices);
+		outLodErrors.push_back(outLodErrors.back() + error * errorScale);
+	}
+}
+
+vec3 getVertexPosition(const MeshData &m, const Mesh &mesh, uint32_t vertex)
+{
+	const uint8_t *v = m.vertexData.data() + (size_t)vertex * m.streams.getVertexSize();
+
+	if (m.streams.attributes[0].format == lvk::VertexFormat::UShort4Norm)
+	{
+		uint16_t q[4];
+		memcpy(q, v, sizeof(q));
+		return vec3(q[0], q[1], q[2]) / 65535.0f * vec3(mesh.posScale[0], mesh.posScale[1], mesh.posScale[2]) +
+			   vec3(mesh.posOffset[0], mesh.posOffset[1], mesh.posOffset[2]);
+	}
+
+	float f[3];
+	memcpy(f, v, sizeof(f));
+	return vec3(f[0], f[1], f[2]);
+}
+
+static uint32_t getPositionSize(lvk::VertexFormat format)
+{
+	LVK_ASSERT(format == lvk::VertexFormat::Float3 || format == lvk::VertexFormat::UShort4Norm);
+
+	return format == lvk::VertexFormat::UShort4Norm ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+}
+
+lvk::VertexInput getPositionStream(const lvk::VertexInput &streams)
+{
+	const lvk::VertexFormat format = streams.attributes[0].format;
+
+	return {
+		.attributes = {{.location = 0, .format = format, .offset = 0}},
+		.inputBindings = {{.stride = getPositionSize(format)}},
+	};
+}
+
+void extractPositions(const lvk::VertexInput &streams, const uint8_t *vertexData, uint32_t numVertices, uint8_t *dst)
+{
+	const size_t vertexSize = streams.getVertexSize();
+	const size_t offset = streams.attributes[0].offset;
+	const uint32_t positionSize = getPositionSize(streams.attributes[0].format);
+
+	for (uint32_t i = 0; i != numVertices; i++)
+		memcpy(dst + (size_t)i * positionSize, vertexData + i * vertexSize + offset, positionSize);
+}
+
+bool generateShadowIndices(const Mesh &mesh, const void *indices, const uint8_t *positions, uint32_t positionSize, void *dst)
+{
+	const uint32_t numIndices = mesh.lodOffset[mesh.lodCount];
+	const size_t indexSize = mesh.isIndex16() ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	if (mesh.isIndex16())
+		meshopt_generateShadowIndexBuffer(
+			(uint16_t *)dst, (const uint16_t *)indices, numIndices, positions, mesh.vertexCount, positionSize, positionSize);
+	else
+		meshopt_generateShadowIndexBuffer(
+			(uint32_t *)dst, (const uint32_t *)indices, numIndices, positions, mesh.vertexCount, positionSize, positionSize);
+
+	return memcmp(dst, indices, numIndices * indexSize) != 0;
+}
+
+PositionQuantizationReport quantizeMeshPositions(MeshData &m)
+{
+	PositionQuantizationReport report;
+
+	const lvk::VertexInput::VertexAttribute &pos = m.streams.attributes[0];
+
+	if (pos.format != lvk::VertexFormat::Float3 || pos.offset != 0)
+	{
+		printf("Positions are already quantized or not Float3 at offset 0.\n");
+		return report;
+	}
+
+	const uint32_t stride = m.streams.getVertexSize();
+	// 3 floats become 4 unsigned shorts (the 4th one is padding to keep the vertex 4-byte aligned)
+	const uint32_t newStride = stride - 3 * sizeof(float) + 4 * sizeof(uint16_t);
+	const uint32_t numVertices = (uint32_t)(m.vertexData.size() / stride);
+
+	struct VertexRange
+	{
+		uint32_t first = 0;
+		uint32_t last = 0;
+		uint32_t mesh = 0;
+	};
+
+	// the range of vertices referenced by each mesh (all LODs)
+	std::vector<VertexRange> ranges;
+	ranges.reserve(m.meshes.size());
+
+	for (uint32_t i = 0; i != (uint32_t)m.meshes.size(); i++)
+	{
+		const Mesh &mesh = m.meshes[i];
+		const uint32_t numIndices = mesh.lodOffset[mesh.lodCount];
+
+		if (!numIndices)
+			continue;
+
+		uint32_t minIndex = std::numeric_limits<uint32_t>::max();
+		uint32_t maxIndex = 0;
+
+		for (uint32_t j = 0; j != numIndices; j++)
+		{
+			const uint32_t idx = getMeshIndex(m, mesh, j);
+			minIndex = std::min(minIndex, idx);
+			maxIndex = std::max(maxIndex, idx);
+		}
+
+		ranges.push_back({mesh.vertexOffset + minIndex, mesh.vertexOffset + maxIndex, i});
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const VertexRange &a, const VertexRange &b)
+			  { return a.first < b.first; });
+
+	// a vertex can be dequantized in only one way, so meshes with overlapping ranges share a group
+	std::vector<VertexRange> groups;
+	std::vector<uint32_t> groupForMesh(m.meshes.size(), ~0u);
+
+	for (const VertexRange &r : ranges)
+	{
+		if (groups.empty() || r.first > groups.back().last)
+			groups.push_back(r);
+		else
+			groups.back().last = std::max(groups.back().last, r.last);
+
+		groupForMesh[r.mesh] = (uint32_t)groups.size() - 1;
+	}
+
+	auto readPosition = [&m, stride](uint32_t v)
+	{
+		float f[3];
+		memcpy(f, m.vertexData.data() + (size_t)v * stride, sizeof(f));
+		return vec3(f[0], f[1], f[2]);
+	};
+
+	// the attributes following the position keep their relative order
+	std::vector<uint8_t> newVertexData((size_t)numVertices * newStride, 0);
+
+	for (uint32_t v = 0; v != numVertices; v++)
+	{
+		memcpy(
+			newVertexData.data() + (size_t)v * newStride + 4 * sizeof(uint16_t), m.vertexData.data() + (size_t)v * stride + 3 * sizeof(float),
+			stride - 3 * sizeof(float));
+	}
+
+	std::vector<BoundingBox> groupBoxes;
+	groupBoxes.reserve(groups.size());
+
+	double sumError = 0.0;
+
+	for (const VertexRange &g : groups)
+	{
+		vec3 vmin(std::numeric_limits<float>::max());
+		vec3 vmax(std::numeric_limits<float>::lowest());
+
+		for (uint32_t v = g.first; v <= g.last; v++)
+		{
+			vmin = glm::min(vmin, readPosition(v));
+			vmax = glm::max(vmax, readPosition(v));
+		}
+
+		groupBoxes.emplace_back(vmin, vmax);
+
+		const vec3 scale = vmax - vmin;
+		const float diagonal = glm::length(scale);
+
+		for (uint32_t v = g.first; v <= g.last; v++)
 		{
-			const uint32_t vtxOffset = m.indexData[mesh.indexOffset + i] + mesh.vertexOffset;
-			const float *vf = (const float *)&m.vertexData[vtxOffset * stride];
+			const vec3 p = readPosition(v);
+			const vec3 t = glm::clamp((p - vmin) / glm::max(scale, vec3(std::numeric_limits<float>::min())), vec3(0.0f), vec3(1.0f));
+			const uint16_t q[4] = {
+				(uint16_t)(t.x * 65535.0f + 0.5f),
+				(uint16_t)(t.y * 65535.0f + 0.5f),
+				(uint16_t)(t.z * 65535.0f + 0.5f),
+				0,
+			};
+			memcpy(newVertexData.data() + (size_t)v * newStride, q, sizeof(q));
+
+			const float error = glm::length(vec3(q[0], q[1], q[2]) / 65535.0f * scale + vmin - p);
+
+			sumError += error;
+			report.maxError = std::max(report.maxError, error);
+			if (diagonal > 0.0f)
+				report.maxRelativeError = std::max(report.maxRelativeError, error / diagonal);
+			report.numVertices++;
+		}
+	}
+
+	for (size_t i = 0; i != m.meshes.size(); i++)
+	{
+		Mesh &mesh = m.meshes[i];
+
+		if (groupForMesh[i] == ~0u)
+			continue;
 
-			vmin = glm::min(vmin, vec3(vf[0], vf[1], vf[2]));
-			vmax = glm::max(vmax, vec3(vf[0], vf[1], vf[2]));
+		const BoundingBox &box = groupBoxes[groupForMesh[i]];
+
+		for (int c = 0; c != 3; c++)
+		{
+			mesh.posOffset[c] = box.min_[c];
+			mesh.posScale[c] = box.max_[c] - box.min_[c];
 		}
+	}
 
-		m.boxes.emplace_back(vmin, vmax);
+	for (auto &attr : m.streams.attributes)
+	{
+		if (attr.format != lvk::VertexFormat::Invalid && attr.offset >= 3 * sizeof(float))
+			attr.offset -= 3 * sizeof(float) - 4 * sizeof(uint16_t);
 	}
+	m.streams.attributes[0].format = lvk::VertexFormat::UShort4Norm;
+	m.streams.inputBindings[0].stride = newStride;
+
+	report.numGroups = (uint32_t)groups.size();
+	report.vertexDataSizeBefore = m.vertexData.size();
+	report.vertexDataSizeAfter = newVertexData.size();
+	report.avgError = report.numVertices ? (float)(sumError / report.numVertices) : 0.0f;
+
+	m.vertexData = std::move(newVertexData);
+
+	printf(
+		"Quantized positions: %u vertices in %u groups, vertex data %zu -> %zu bytes\n"
+		"   error: max %g, avg %g, max relative to the box diagonal %g\n",
+		report.numVertices, report.numGroups, report.vertexDataSizeBefore, report.vertexDataSizeAfter, report.maxError, report.avgError,
+		report.maxRelativeError);
+
+	return report;
 }
@@ -2,6 +2,10 @@
 
 #include <stdint.h>
 
+#include <atomic>
+#include <memory>
+#include <span>
+
 #include <glm/glm.hpp>
 
 #include "shared/Utils.h"
@@ -9,6 +13,21 @@
 
 constexpr const uint32_t kMaxLODs = 7;
 
+constexpr const uint32_t kMeshFileMagic = 0x12345678;
+// v2 container with 64-bit sections and a table of contents (see MeshFileHeaderV2)
+constexpr const uint32_t kMeshFileMagicV2 = 0x1234567A;
+
+namespace tf
+{
+class Executor;
+}
+
+enum MeshFlags
+{
+	// indices are stored in MeshData::indexData16 instead of MeshData::indexData
+	sMeshFlags_Index16 = 0x1,
+};
+
 // All offsets are relative to the beginning of the data block (excluding headers with a Mesh list)
 struct Mesh final
 {
@@ -28,15 +47,59 @@ struct Mesh final
 
 	uint32_t materialID = 0;
 
+	// sMeshFlags_*
+	uint32_t flags = 0;
+
+	// dequantization of vertex positions: position = stored position * posScale + posOffset (see quantizeMeshPositions())
+	float posOffset[3] = {0.0f, 0.0f, 0.0f};
+	float posScale[3] = {1.0f, 1.0f, 1.0f};
+
+	// range of MeshData::meshlets covering the LOD0 indices of this mesh (see generateMeshlets())
+	uint32_t meshletOffset = 0;
+	uint32_t meshletCount = 0;
+
+	// Simplification error of every LOD in mesh space (the same units as the dequantized positions). LOD0 is exact
+	float lodError[kMaxLODs] = {0.0f};
+
 	inline uint32_t getLODIndicesCount(uint32_t lod) const { return lod < lodCount ? lodOffset[lod + 1] - lodOffset[lod] : 0; }
 
+	inline bool isIndex16() const { return (flags & sMeshFlags_Index16) != 0; }
+
 	// Any additional information, such as mesh name, can be added here...
 };
 
+// A cluster of LOD0 triangles of a mesh. The LOD0 indices are reordered so that every meshlet is a contiguous range
+struct Meshlet
+{
+	// relative to Mesh::indexOffset, so a meshlet is drawn with firstIndex = Mesh::indexOffset + indexOffset
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	// bounding sphere in mesh space
+	float center[3] = {0.0f, 0.0f, 0.0f};
+	float radius = 0.0f;
+	// normal cone in mesh space: all triangles are backfacing if dot(normalize(apex - cameraPos), axis) >= cutoff
+	float coneApex[3] = {0.0f, 0.0f, 0.0f};
+	float coneAxis[3] = {0.0f, 0.0f, 0.0f};
+	float coneCutoff = 1.0f;
+};
+
+static_assert(sizeof(Meshlet) == 13 * sizeof(uint32_t));
+
+// matches VkDrawIndexedIndirectCommand
+struct DrawIndexedIndirectCommand
+{
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// header of v1 files, its 32-bit sizes cannot describe v2 files (see MeshFileHeaderV2)
 struct MeshFileHeader
 {
 	// Unique 64-bit value to check integrity of the file
-	uint32_t magicValue = 0x12345678;
+	uint32_t magicValue = kMeshFileMagic;
 
 	// Number of mesh descriptors following this header
 	uint32_t meshCount = 0;
@@ -50,6 +113,85 @@ struct MeshFileHeader
 	// According to your needs, you may add additional metadata fields...
 };
 
+enum MeshFileSectionType : uint32_t
+{
+	MeshFileSection_Streams = 0,
+	MeshFileSection_Meshes,
+	MeshFileSection_Boxes,
+	MeshFileSection_Indices,
+	MeshFileSection_Vertices,
+	MeshFileSection_Indices16,
+	MeshFileSection_Meshlets,
+	MeshFileSection_Spheres,
+	MeshFileSection_OBBs,
+	// compressed files (see saveMeshDataCompressed()) store these two instead of the index and vertex sections
+	MeshFileSection_CodecChunks,
+	MeshFileSection_EncodedGeometry,
+	// Depth-only geometry written by saveMeshData(): the position stream of getPositionStream() and the indices of generateShadowIndices(),
+	// laid out like the vertex and index sections. Optional, readers build them from the geometry if a file has none
+	MeshFileSection_Positions,
+	MeshFileSection_ShadowIndices,
+	MeshFileSection_ShadowIndices16,
+	MeshFileSection_Count,
+};
+
+enum MeshFileSectionBits : uint32_t
+{
+	sMeshFileSectionBits_Streams = 1 << MeshFileSection_Streams,
+	sMeshFileSectionBits_Meshes = 1 << MeshFileSection_Meshes,
+	sMeshFileSectionBits_Boxes = 1 << MeshFileSection_Boxes,
+	sMeshFileSectionBits_Indices = 1 << MeshFileSection_Indices,
+	sMeshFileSectionBits_Vertices = 1 << MeshFileSection_Vertices,
+	sMeshFileSectionBits_Indices16 = 1 << MeshFileSection_Indices16,
+	sMeshFileSectionBits_Meshlets = 1 << MeshFileSection_Meshlets,
+	sMeshFileSectionBits_Spheres = 1 << MeshFileSection_Spheres,
+	sMeshFileSectionBits_OBBs = 1 << MeshFileSection_OBBs,
+	sMeshFileSectionBits_CodecChunks = 1 << MeshFileSection_CodecChunks,
+	sMeshFileSectionBits_EncodedGeometry = 1 << MeshFileSection_EncodedGeometry,
+	sMeshFileSectionBits_Positions = 1 << MeshFileSection_Positions,
+	sMeshFileSectionBits_ShadowIndices = 1 << MeshFileSection_ShadowIndices,
+	sMeshFileSectionBits_ShadowIndices16 = 1 << MeshFileSection_ShadowIndices16,
+	sMeshFileSectionBits_Metadata = sMeshFileSectionBits_Streams | sMeshFileSectionBits_Meshes | sMeshFileSectionBits_Boxes |
+									sMeshFileSectionBits_Meshlets | sMeshFileSectionBits_Spheres | sMeshFileSectionBits_OBBs,
+	sMeshFileSectionBits_Geometry = sMeshFileSectionBits_Indices | sMeshFileSectionBits_Vertices | sMeshFileSectionBits_Indices16,
+	sMeshFileSectionBits_Encoded = sMeshFileSectionBits_CodecChunks | sMeshFileSectionBits_EncodedGeometry,
+	sMeshFileSectionBits_DepthGeometry = sMeshFileSectionBits_Positions | sMeshFileSectionBits_ShadowIndices | sMeshFileSectionBits_ShadowIndices16,
+	// everything a MeshData holds; the geometry of compressed files is decoded
+	sMeshFileSectionBits_All = sMeshFileSectionBits_Metadata | sMeshFileSectionBits_Geometry,
+};
+
+// sections are checksummed in chunks of this size, so a reader verifies only the chunks it reads
+constexpr const uint32_t kMeshFileChunkSize = 1024 * 1024;
+
+// v2 .meshes file layout:
+//   | MeshFileHeaderV2 | MeshFileSection[numSections] | uint64 chunkChecksums[numChunks] | section data, every section is 16-byte aligned |
+// Section sizes are 64-bit, so a file is not limited to 4 GB. Readers skip unknown section types.
+// Every section is split into chunkSize-byte chunks (the last one can be shorter), each chunk has its hashBytes() in the checksum table.
+// Mesh::indexOffset and Mesh::vertexOffset remain 32-bit element counts because that is what indirect draw commands take
+struct MeshFileHeaderV2
+{
+	uint32_t magicValue = kMeshFileMagicV2;
+	uint32_t numSections = 0;
+	uint64_t fileSize = 0;
+	uint32_t chunkSize = kMeshFileChunkSize;
+	uint32_t numChunks = 0;
+};
+
+// an entry in the table of contents
+struct MeshFileSection
+{
+	uint32_t type = 0;
+	// checksum of the first chunk of this section in the checksum table
+	uint32_t firstChunk = 0;
+	// relative to the beginning of the file
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	uint64_t reserved = 0;
+};
+
+static_assert(sizeof(MeshFileHeaderV2) == 24);
+static_assert(sizeof(MeshFileSection) == 32);
+
 enum MaterialFlags
 {
 	sMaterialFlags_CastShadow = 0x1,
@@ -77,35 +219,234 @@ struct MeshData
 {
 	lvk::VertexInput streams = {};
 	std::vector<uint32_t> indexData;
+	// indices of the meshes with sMeshFlags_Index16, i.e. meshes with no more than 65536 vertices
+	std::vector<uint16_t> indexData16;
 	std::vector<uint8_t> vertexData;
 	std::vector<Mesh> meshes;
 	std::vector<BoundingBox> boxes;
+	// one per mesh, like boxes
+	std::vector<BoundingSphere> spheres;
+	std::vector<OrientedBoundingBox> obbs;
+	std::vector<Meshlet> meshlets;
 	std::vector<Material> materials;
 	std::vector<std::string> textureFiles;
-	MeshFileHeader getMeshFileHeader() const
-	{
-		return {
-			.meshCount = (uint32_t)meshes.size(),
-			.indexDataSize = (uint32_t)(indexData.size() * sizeof(uint32_t)),
-			.vertexDataSize = (uint32_t)vertexData.size(),
-		};
-	}
 };
 
 static_assert(sizeof(BoundingBox) == sizeof(float) * 6);
+static_assert(sizeof(BoundingSphere) == sizeof(float) * 4);
+static_assert(sizeof(OrientedBoundingBox) == sizeof(float) * 12);
+
+// i-th index of the mesh, taken from the index array matching its index format
+inline uint32_t getMeshIndex(const MeshData &m, const Mesh &mesh, uint32_t i)
+{
+	return mesh.isIndex16() ? m.indexData16[mesh.indexOffset + i] : m.indexData[mesh.indexOffset + i];
+}
+
+enum MeshCodecChunkFlags
+{
+	sMeshCodecChunk_Index = 0x1,
+	// encoded with meshopt_encodeIndexSequence() because the range is not a whole number of triangles
+	sMeshCodecChunk_IndexSequence = 0x2,
+	sMeshCodecChunk_Vertex = 0x4,
+	// indices of MeshData::indexData16
+	sMeshCodecChunk_Index16 = 0x8,
+};
+
+// A range of indices or vertices encoded independently of all other ranges, so every chunk can be decoded on its own thread.
+// Chunks start at mesh boundaries and together cover the index and vertex data without gaps. The elements are addressed with 32-bit
+// offsets like Mesh::indexOffset and Mesh::vertexOffset, the encoded bytes with 64-bit offsets
+struct MeshCodecChunk
+{
+	uint32_t flags = 0;
+	// first index or vertex of this chunk in MeshData::indexData, MeshData::indexData16 or MeshData::vertexData
+	uint32_t firstElement = 0;
+	uint32_t numElements = 0;
+	uint32_t reserved = 0;
+	// location of the encoded bytes relative to the beginning of the MeshFileSection_EncodedGeometry section
+	uint64_t encodedOffset = 0;
+	uint64_t encodedSize = 0;
+};
+
+static_assert(sizeof(MeshCodecChunk) == 32);
+
+// The encoded geometry of a compressed .meshes file. Non-owning: the spans point into a mapped file or into buffers owned by the caller.
+// The decoded sizes are not stored in the file, they follow from the chunks
+struct CompressedMeshData
+{
+	lvk::VertexInput streams = {};
+	std::span<const MeshCodecChunk> chunks;
+	std::span<const uint8_t> encodedData;
+	// decoded sizes in bytes
+	uint64_t indexDataSize = 0;
+	uint64_t indexData16Size = 0;
+	uint64_t vertexDataSize = 0;
+};
+
+// Read-only view of the geometry in a .meshes file mapped into memory. Nothing is copied: the spans point straight
+// into the mapping and the OS pages the data in on first access (e.g. when it is uploaded to the GPU).
+// Compressed files are mapped as well, but their geometry spans are empty: every mesh is decoded on demand from `compressed`
+// with decodeMeshGeometry().
+// The metadata sections of v2 files are verified by loadMeshDataView(), the geometry chunks by verifyChunks() on first access
+struct MeshDataView
+{
+	lvk::VertexInput streams = {};
+	std::span<const Mesh> meshes;
+	std::span<const BoundingBox> boxes;
+	std::span<const BoundingSphere> spheres;
+	std::span<const OrientedBoundingBox> obbs;
+	std::span<const Meshlet> meshlets;
+	std::span<const uint32_t> indexData;
+	std::span<const uint16_t> indexData16;
+	std::span<const uint8_t> vertexData;
+	// see MeshFileSection_Positions, empty if hasDepthGeometry() is false
+	std::span<const uint8_t> positions;
+	std::span<const uint32_t> shadowIndices;
+	std::span<const uint16_t> shadowIndices16;
+	CompressedMeshData compressed;
+
+	MeshDataView() = default;
+	// non-owning view of an in-memory MeshData
+	explicit MeshDataView(const MeshData &m);
+	~MeshDataView();
+
+	MeshDataView(const MeshDataView &) = delete;
+	MeshDataView &operator=(const MeshDataView &) = delete;
+	MeshDataView(MeshDataView &&other) noexcept;
+	MeshDataView &operator=(MeshDataView &&other) noexcept;
+
+	bool isMapped() const { return mappedPtr_ != nullptr; }
+	bool isCompressed() const { return isCompressed_; }
+	// false for compressed and v1 files and for views of an in-memory MeshData
+	bool hasDepthGeometry() const { return hasDepthGeometry_; }
+	void unmap();
+
+	// decoded sizes in bytes, valid for compressed files too
+	size_t getIndexDataSize() const;
+	size_t getIndexData16Size() const;
+	size_t getVertexDataSize() const;
+
+	// Verify the checksums of the chunks of the mapped file overlapping [data, data + size), e.g. right before the geometry is uploaded.
+	// Every chunk is hashed only once, from any thread. Returns false for a mismatch or a range outside of the sections of the file.
+	// Always true for views of an in-memory MeshData and for v1 files, which have no checksums
+	bool verifyChunks(const void *data, size_t size) const;
+	// the indices and the vertices of the mesh (and its depth-only geometry), or its encoded chunks in compressed files
+	bool verifyMeshGeometry(const Mesh &mesh) const;
+
+	// Drop the resident pages of the index and vertex data of a mapped file, e.g. once they are uploaded to the GPU. Everything else
+	// (meshes, bounding volumes, meshlets) stays resident. The spans remain valid, the pages are read back from the file on the next
+	// access. For compressed files the encoded geometry is dropped the same way.
+	// Returns the number of released bytes, 0 for views of an in-memory MeshData
+	size_t evictGeometry();
+
+private:
+	friend bool loadMeshDataView(const char *meshFile, MeshDataView &out);
+
+	void *mappedPtr_ = nullptr;
+	size_t mappedSize_ = 0;
+	bool isCompressed_ = false;
+	bool hasDepthGeometry_ = false;
+	// table of contents and checksums of a mapped v2 file, see verifyChunks()
+	std::vector<MeshFileSection> sections_;
+	std::span<const uint64_t> checksums_;
+	uint32_t chunkSize_ = 0;
+	std::unique_ptr<std::atomic<uint8_t>[]> chunkVerified_;
+#if defined(_WIN32)
+	void *hFile_ = nullptr;
+	void *hMapping_ = nullptr;
+#endif
+};
 
 bool isMeshDataValid(const char *fileName);
+// Read the table of contents of a v1 or v2 .meshes file. v1 files have no checksums
+bool loadMeshFileSections(const char *meshFile, std::vector<MeshFileSection> &sections, bool *hasChecksums = nullptr);
+// Read only the sections selected by sectionMask (MeshFileSectionBits) and skip everything else, e.g. just the bounding
+// boxes for a culling service. In v2 files only the checksums of the chunks of the selected sections are verified.
+// The geometry sections of compressed files are decoded from their encoded sections
+bool loadMeshDataSections(const char *meshFile, uint32_t sectionMask, MeshData &out);
 bool isMeshMaterialsValid(const char *fileName);
 bool isMeshHierarchyValid(const char *fileName);
-MeshFileHeader loadMeshData(const char *meshFile, MeshData &out);
+// v1 and v2 files; the sizes of the loaded data are the sizes of the vectors of `out`, MeshFileHeader is 32-bit and only describes v1 files
+void loadMeshData(const char *meshFile, MeshData &out);
+// map a .meshes file instead of reading it; returns false if the file cannot be mapped or is truncated
+bool loadMeshDataView(const char *meshFile, MeshDataView &out);
 void loadMeshDataMaterials(const char *meshFile, MeshData &out);
+// Writes the v2 container including the depth-only geometry (see MeshFileSection_Positions). loadMeshData() and loadMeshDataView() read
+// both v1 and v2 files
 void saveMeshData(const char *fileName, const MeshData &m);
+// Same as saveMeshData(), but the index and vertex data are encoded with meshoptimizer and stored in the MeshFileSection_CodecChunks and
+// MeshFileSection_EncodedGeometry sections of the v2 container. loadMeshData() decodes them, loadMeshDataView() maps them as they are.
+// The depth-only geometry is not stored, it is built from the decoded geometry
+void saveMeshDataCompressed(const char *fileName, const MeshData &m);
+
+// Decode all chunks in parallel straight into the destination memory, e.g. mapped staging or host-visible GPU buffers.
+// dstIndices, dstIndices16 and dstVertices must hold indexDataSize, indexData16Size and vertexDataSize bytes.
+// Returns false on corrupted data
+bool decodeMeshData(
+	const CompressedMeshData &data, uint32_t *dstIndices, uint16_t *dstIndices16, uint8_t *dstVertices, tf::Executor &executor);
+// Decode the indices (all LODs, in the index format of the mesh) and the vertices of a single mesh, e.g. to stream it to the GPU.
+// Every mesh is encoded in its own chunks, so nothing else is decoded. Returns false on corrupted data
+bool decodeMeshGeometry(const CompressedMeshData &data, const Mesh &mesh, std::vector<uint8_t> &indices, std::vector<uint8_t> &vertices);
+// Same as above, straight into indices and vertices (e.g. a staging buffer) with room for the geometry of the mesh only: all LODs and
+// Mesh::vertexCount vertices
+bool decodeMeshGeometry(const CompressedMeshData &data, const Mesh &mesh, void *indices, uint8_t *vertices);
 void saveMeshDataMaterials(const char *fileName, const MeshData &m);
 
+// AABBs of all meshes (MeshData::boxes), cheap enough to run after every merge. The spheres and the OBBs are cleared
 void recalculateBoundingBoxes(MeshData &m);
+// Bounding spheres and oriented bounding boxes of all meshes (MeshData::spheres and obbs) from the positions and the AABBs. Expensive,
+// run it once right before saveMeshData() or saveMeshDataCompressed()
+void recalculateBoundingVolumes(MeshData &m);
+
+struct PositionQuantizationReport
+{
+	uint32_t numVertices = 0;
+	// meshes referencing overlapping vertex ranges share one quantization box
+	uint32_t numGroups = 0;
+	size_t vertexDataSizeBefore = 0;
+	size_t vertexDataSizeAfter = 0;
+	// distance between the original and the dequantized positions, in model space units
+	float maxError = 0.0f;
+	float avgError = 0.0f;
+	// maxError relative to the diagonal of the quantization box
+	float maxRelativeError = 0.0f;
+};
+
+// Replace Float3 positions with UShort4Norm positions relative to the bounds of the vertices each mesh references. The dequantization
+// scale and offset are stored in every Mesh and passed to the vertex shaders through DrawData. Run it after recalculateBoundingBoxes()
+PositionQuantizationReport quantizeMeshPositions(MeshData &m);
+
+// Split the LOD0 triangles of every mesh into meshlets with meshopt_buildMeshlets() and reorder the LOD0 indices to match.
+// Computes the bounding sphere and the normal cone of every meshlet. Run it after all the meshes are merged
+void generateMeshlets(MeshData &m, uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+// Weld identical vertices, then reorder the triangles for the vertex cache and overdraw and the vertices for the fetch order.
+// indices are local to `vertices`, which must start with Float3 positions; unreferenced vertices are dropped
+void optimizeMeshGeometry(std::vector<uint32_t> &indices, std::vector<uint8_t> &vertices, size_t vertexStride);
+
+// LOD0 is `indices` itself; more LODs are appended to outLods if generateLods is set. The vertices must have the layout of
+// getAIMeshVertexStreams(). `indices` is overwritten by the last LOD
+void processLODs(
+	std::vector<uint32_t> &indices, std::vector<uint8_t> &vertices, size_t vertexStride, std::vector<std::vector<uint32_t>> &outLods,
+	std::vector<float> &outLodErrors, bool generateLods);
+
+// model space position of a vertex of the mesh; works with both Float3 and quantized positions
+vec3 getVertexPosition(const MeshData &m, const Mesh &mesh, uint32_t vertex);
+
+// Position-only vertex stream for depth-only passes (shadow maps, depth pre-pass): attribute 0 of `streams` tightly packed
+lvk::VertexInput getPositionStream(const lvk::VertexInput &streams);
+// true for the streams returned by getPositionStream()
+inline bool isPositionStream(const lvk::VertexInput &streams) { return streams.getNumAttributes() == 1; }
+// copy the positions of numVertices interleaved vertices into a position-only stream (see getPositionStream())
+void extractPositions(const lvk::VertexInput &streams, const uint8_t *vertexData, uint32_t numVertices, uint8_t *dst);
+
+// Indices for position-only draws with the same layout as the indices of the mesh: every index points to the first vertex of the mesh
+// with the same position, so the vertex cache hits across UV and normal seams. indices and dst are 16-bit if mesh.isIndex16(), all
+// LODs are remapped. Returns false if no index changed
+bool generateShadowIndices(const Mesh &mesh, const void *indices, const uint8_t *positions, uint32_t positionSize, void *dst);
 
-// combine a list of meshes to a single mesh container
-MeshFileHeader mergeMeshData(MeshData &m, const std::vector<MeshData *> md);
+// combine a list of meshes to a single mesh container; materialRemap maps the material indices of the concatenated material lists to
+// the merged ones (see mergeMaterialLists())
+void mergeMeshData(MeshData &m, const std::vector<MeshData *> md, const std::vector<uint32_t> &materialRemap = {});
 
 // use to write values into MeshData::vertexData
 template <typename T>
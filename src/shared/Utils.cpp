@@ -10,6 +10,8 @@
 #include <ktx.h>
 #include <gl_format.h>
 
+#include <bit>
+#include <thread>
 #include <unordered_map>
 
 // lvk::ShaderModuleHandle -> GLSL source code
@@ -271,18 +273,42 @@ void loadStringList(FILE *f, std::vector<std::string> &lines)
 	}
 }
 
-int addUnique(std::vector<std::string> &files, const std::string &file)
+std::string normalizePath(const std::string &path)
 {
-	if (file.empty())
+	std::string result;
+	result.reserve(path.size());
+
+	for (size_t i = 0; i != path.size(); i++)
+	{
+		const char c = path[i] == '\\' ? '/' : path[i];
+
+		if (c == '/' && !result.empty() && result.back() == '/')
+			continue;
+
+		// drop "./" at the beginning and after a separator
+		if (c == '.' && (result.empty() || result.back() == '/') && i + 1 < path.size() && (path[i + 1] == '/' || path[i + 1] == '\\'))
+		{
+			i++;
+			continue;
+		}
+
+		result.push_back(c);
+	}
+
+	return result;
+}
+
+int internPath(StringTable &table, const std::string &path)
+{
+	if (path.empty())
 		return -1;
 
-	const auto i = std::find(std::begin(files), std::end(files), file);
+	const auto i = table.ids.try_emplace(normalizePath(path), (int)table.strings.size());
 
-	if (i != files.end())
-		return (int)std::distance(files.begin(), i);
+	if (i.second)
+		table.strings.push_back(path);
 
-	files.push_back(file);
-	return (int)files.size() - 1;
+	return i.first->second;
 }
 
 std::string replaceAll(const std::string &str, const std::string &oldSubStr, const std::string &newSubStr)
@@ -302,3 +328,95 @@ std::string lowercaseString(const std::string &s)
 	std::transform(s.begin(), s.end(), out.begin(), tolower);
 	return out;
 }
+
+static uint32_t numConversionThreads = 0;
+
+void setNumConversionThreads(uint32_t numThreads)
+{
+	numConversionThreads = numThreads;
+}
+
+uint32_t getNumConversionThreads()
+{
+	return numConversionThreads ? numConversionThreads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// XXH64: four independent 64-bit lanes consume 32 bytes per iteration, so the multiplications of neighbouring words overlap
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+{
+	constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+	constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+	constexpr uint64_t kPrime3 = 0x165667b19e3779f9ull;
+	constexpr uint64_t kPrime4 = 0x85ebca77c2b2ae63ull;
+	constexpr uint64_t kPrime5 = 0x27d4eb2f165667c5ull;
+
+	auto round = [](uint64_t acc, uint64_t word)
+	{
+		return std::rotl(acc + word * kPrime2, 31) * kPrime1;
+	};
+	auto mergeRound = [&round](uint64_t hash, uint64_t lane)
+	{
+		return (hash ^ round(0, lane)) * kPrime1 + kPrime4;
+	};
+	auto read64 = [](const uint8_t *p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	};
+	auto read32 = [](const uint8_t *p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	};
+
+	const uint8_t *p = (const uint8_t *)data;
+	const uint8_t *end = p + size;
+
+	uint64_t hash = seed + kPrime5;
+
+	if (size >= 32)
+	{
+		uint64_t v1 = seed + kPrime1 + kPrime2;
+		uint64_t v2 = seed + kPrime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - kPrime1;
+
+		for (; end - p >= 32; p += 32)
+		{
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+
+		hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+		hash = mergeRound(hash, v1);
+		hash = mergeRound(hash, v2);
+		hash = mergeRound(hash, v3);
+		hash = mergeRound(hash, v4);
+	}
+
+	hash += size;
+
+	for (; end - p >= 8; p += 8)
+		hash = std::rotl(hash ^ round(0, read64(p)), 27) * kPrime1 + kPrime4;
+
+	if (end - p >= 4)
+	{
+		hash = std::rotl(hash ^ (read32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+		p += 4;
+	}
+
+	for (; p != end; p++)
+		hash = std::rotl(hash ^ (*p * kPrime5), 11) * kPrime1;
+
+	hash ^= hash >> 33;
+	hash *= kPrime2;
+	hash ^= hash >> 29;
+	hash *= kPrime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
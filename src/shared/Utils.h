@@ -4,6 +4,7 @@
 #include <memory>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #if !defined(__APPLE__)
 #include <malloc.h>
@@ -50,6 +51,25 @@ inline void eraseSelected(std::vector<T> &v, const std::vector<Index> &selection
 
 void saveStringList(FILE *f, const std::vector<std::string> &lines);
 void loadStringList(FILE *f, std::vector<std::string> &lines);
-int addUnique(std::vector<std::string> &files, const std::string &file);
+
+// Interned file paths with stable IDs: the ID of a path is its index in `strings`, lookups are O(1). Paths are keyed by normalizePath(),
+// so different spellings of the same file share one ID; the first spelling is the one stored in `strings`
+struct StringTable
+{
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, int> ids;
+};
+
+// forward slashes, no repeated slashes and no "./" components
+std::string normalizePath(const std::string &path);
+// returns the ID of the path, adding it if needed; -1 for an empty path
+int internPath(StringTable &table, const std::string &path);
 std::string replaceAll(const std::string &str, const std::string &oldSubStr, const std::string &newSubStr);
 std::string lowercaseString(const std::string &s); // convert 8-bit ASCII string to upper case
+
+// Worker threads of the offline conversion passes (textures, meshes, bounding volumes), 0 selects all hardware threads
+void setNumConversionThreads(uint32_t numThreads);
+uint32_t getNumConversionThreads();
+
+// 64-bit XXH64 hash of a block of memory. Pass the previous result as 'seed' to hash data in several pieces
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
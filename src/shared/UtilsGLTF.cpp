@@ -1298,26 +1298,6 @@ MaterialType detectMaterialType(const aiMaterial *mtl)
 	return MaterialType_Invalid;
 }
 
-void printPrefix(int ofs)
-{
-	for (int i = 0; i < ofs; i++)
-		printf("\t");
-}
-
-void printMat4(const aiMatrix4x4 &m)
-{
-	if (!m.IsIdentity())
-	{
-		for (int i = 0; i < 4; i++)
-			for (int j = 0; j < 4; j++)
-				printf("%f ;", m[i][j]);
-	}
-	else
-	{
-		printf(" Identity");
-	}
-}
-
 void animateGLTF(GLTFContext &gltf, AnimationState &anim, float dt)
 {
 	if (gltf.transforms.empty())
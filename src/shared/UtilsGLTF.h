@@ -545,9 +545,6 @@ void animateGLTF(GLTFContext &gltf, AnimationState &anim, float dt);
 void animateBlendingGLTF(GLTFContext &gltf, AnimationState &anim1, AnimationState &anim2, float weight, float dt);
 MaterialType detectMaterialType(const aiMaterial *mtl);
 
-void printPrefix(int ofs);
-void printMat4(const aiMatrix4x4 &m);
-
 std::vector<std::string> camerasGLTF(GLTFContext &context);
 void updateCamera(GLTFContext &gltf, const mat4 &model, mat4 &view, mat4 &proj, float aspectRatio);
 
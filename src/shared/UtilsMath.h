@@ -78,6 +78,54 @@ struct BoundingBox
 	}
 };
 
+struct BoundingSphere
+{
+	vec3 center = vec3(0.0f);
+	float radius = 0.0f;
+	// the radius is scaled by the largest scaling factor of t
+	BoundingSphere getTransformed(const glm::mat4 &t) const
+	{
+		const float scale = glm::max(glm::max(glm::length(vec3(t[0])), glm::length(vec3(t[1]))), glm::length(vec3(t[2])));
+		return {vec3(t * vec4(center, 1.0f)), radius * scale};
+	}
+};
+
+// The center and three half-size axes. The axes are orthogonal in mesh space and can be skewed by getTransformed()
+struct OrientedBoundingBox
+{
+	vec3 center = vec3(0.0f);
+	vec3 axes[3] = {vec3(0.0f), vec3(0.0f), vec3(0.0f)};
+	OrientedBoundingBox() = default;
+	explicit OrientedBoundingBox(const BoundingBox &box)
+		: center(box.getCenter())
+	{
+		const vec3 halfSize = 0.5f * box.getSize();
+		axes[0] = vec3(halfSize.x, 0.0f, 0.0f);
+		axes[1] = vec3(0.0f, halfSize.y, 0.0f);
+		axes[2] = vec3(0.0f, 0.0f, halfSize.z);
+	}
+	void getCorners(vec3 *corners) const
+	{
+		for (int i = 0; i != 8; i++)
+			corners[i] = center + ((i & 1) ? axes[0] : -axes[0]) + ((i & 2) ? axes[1] : -axes[1]) + ((i & 4) ? axes[2] : -axes[2]);
+	}
+	OrientedBoundingBox getTransformed(const glm::mat4 &t) const
+	{
+		OrientedBoundingBox b;
+		b.center = vec3(t * vec4(center, 1.0f));
+		for (int i = 0; i != 3; i++)
+			b.axes[i] = glm::mat3(t) * axes[i];
+		return b;
+	}
+	BoundingBox getBoundingBox() const
+	{
+		vec3 corners[8];
+		getCorners(corners);
+		return BoundingBox(corners, 8);
+	}
+	float getVolume() const { return 8.0f * glm::abs(glm::dot(axes[0], glm::cross(axes[1], axes[2]))); }
+};
+
 template <typename T>
 T clamp(T v, T a, T b)
 {
@@ -188,6 +236,67 @@ inline bool isBoxInFrustum(glm::vec4 *frustumPlanes, glm::vec4 *frustumCorners,
 	return true;
 }
 
+// -1 if the sphere is outside of the frustum, +1 if it is entirely inside, 0 if it intersects the frustum planes
+inline int classifySphereInFrustum(const glm::vec4 *frustumPlanes, const vec3 &center, float radius)
+{
+	int result = 1;
+
+	for (int i = 0; i != 6; i++)
+	{
+		// the planes from getFrustumPlanes() are not normalized
+		const float dist = glm::dot(frustumPlanes[i], vec4(center, 1.0f)) / glm::length(vec3(frustumPlanes[i]));
+
+		if (dist < -radius)
+			return -1;
+		if (dist < radius)
+			result = 0;
+	}
+
+	return result;
+}
+
+inline bool isSphereInFrustum(const glm::vec4 *frustumPlanes, const vec3 &center, float radius)
+{
+	return classifySphereInFrustum(frustumPlanes, center, radius) >= 0;
+}
+
+inline bool isOBBInFrustum(glm::vec4 *frustumPlanes, glm::vec4 *frustumCorners, const OrientedBoundingBox &box)
+{
+	using glm::dot;
+
+	vec3 corners[8];
+	box.getCorners(corners);
+
+	for (int i = 0; i < 6; i++)
+	{
+		int r = 0;
+		for (int c = 0; c < 8; c++)
+			r += (dot(frustumPlanes[i], vec4(corners[c], 1.0f)) < 0.0) ? 1 : 0;
+		if (r == 8)
+			return false;
+	}
+
+	// check frustum outside/inside box: the box faces are spanned by pairs of axes
+	for (int i = 0; i < 3; i++)
+	{
+		const vec3 n = glm::cross(box.axes[(i + 1) % 3], box.axes[(i + 2) % 3]);
+		const float extent = glm::abs(dot(box.axes[i], n));
+
+		int above = 0;
+		int below = 0;
+		for (int c = 0; c < 8; c++)
+		{
+			const float d = dot(vec3(frustumCorners[c]) - box.center, n);
+			above += (d > extent) ? 1 : 0;
+			below += (d < -extent) ? 1 : 0;
+		}
+		if (above == 8 || below == 8)
+			return false;
+	}
+
+	return true;
+}
+
 inline BoundingBox combineBoxes(const std::vector<BoundingBox> &boxes)
 {
 	std::vector<vec3> allPoints;
@@ -0,0 +1,91 @@
+// Offline asset converter: runs the conversion pipeline of Nugie_Engine (see precacheBistro()) ahead of time, e.g. on build machines,
+// without a window or a Vulkan device. The cache is written exactly where Nugie_Engine looks for it, relative to the output directory.
+//
+//   Nugie_Converter [--manifest <file>] [--output <dir>] [--threads <n>] [--dry-run]
+//
+//   --manifest  the .obj files and the merged materials (see loadBistroManifest()), the Bistro defaults otherwise
+//   --output    the working directory of Nugie_Engine; the .cache folder and the relative paths of the manifest are resolved from there
+//   --threads   worker threads of the conversion passes, all hardware threads by default
+//   --dry-run   list the stale cache files without converting anything, exits with 1 if anything is stale
+
+#include "Bistro.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize2.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void printUsage()
+{
+	printf("Usage: Nugie_Converter [--manifest <file>] [--output <dir>] [--threads <n>] [--dry-run]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	std::string manifestFile;
+	std::string outputDir;
+	uint32_t numThreads = 0;
+	bool dryRun = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--manifest") && hasValue)
+			manifestFile = argv[++i];
+		else if (!strcmp(argv[i], "--output") && hasValue)
+			outputDir = argv[++i];
+		else if (!strcmp(argv[i], "--threads") && hasValue)
+			numThreads = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "--dry-run"))
+			dryRun = true;
+		else
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	BistroManifest manifest = getDefaultBistroManifest();
+
+	// the manifest is opened before changing into the output directory
+	if (!manifestFile.empty() && !loadBistroManifest(manifestFile.c_str(), manifest))
+		return EXIT_FAILURE;
+
+	if (!outputDir.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(outputDir, ec);
+		std::filesystem::current_path(outputDir, ec);
+
+		if (ec)
+		{
+			printf("Cannot use the output directory %s: %s\n", outputDir.c_str(), ec.message().c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	setNumConversionThreads(numThreads);
+
+	printf(
+		"Converting %u .obj files into %s with %u threads%s\n", (uint32_t)manifest.objFiles.size(),
+		std::filesystem::current_path().string().c_str(), getNumConversionThreads(), dryRun ? " (dry run)" : "");
+
+	const bool isUpToDate = precacheBistro(manifest, dryRun);
+
+	if (dryRun)
+		return isUpToDate ? EXIT_SUCCESS : 1;
+
+	printf(isUpToDate ? "The cache is up to date\n" : "The cache has been rebuilt\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+// Headless validation of VKGlobalTransforms11: the GPU global transforms of a generated deep hierarchy are compared bit-by-bit
+// with the CPU reference recalculateGlobalTransforms(). No window is created, so it runs on build machines with a software
+// Vulkan implementation (e.g. lavapipe). Run it from the same working directory as Nugie_Engine, the shaders are loaded from there.
+//
+//   Nugie_ValidateTransforms [--levels <n>] [--children <n>]
+//
+//   --levels    depth of the hierarchy, MAX_NODE_LEVEL by default
+//   --children  children of every node above the deepest two levels, 3 by default
+
+#include "VKTransforms11.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void printUsage()
+{
+	printf("Usage: Nugie_ValidateTransforms [--levels <n>] [--children <n>]\n");
+}
+
+// deterministic, so a mismatch can be reproduced
+static float randomFloat(uint32_t &state, float minValue, float maxValue)
+{
+	state = state * 1664525u + 1013904223u;
+	return minValue + (maxValue - minValue) * (float)(state >> 8) / (float)(1u << 24);
+}
+
+static mat4 randomTransform(uint32_t &state)
+{
+	const vec3 t(randomFloat(state, -4.0f, 4.0f), randomFloat(state, -4.0f, 4.0f), randomFloat(state, -4.0f, 4.0f));
+	const vec3 axis(randomFloat(state, -1.0f, 1.0f), randomFloat(state, -1.0f, 1.0f), 1.0f);
+	const float angle = randomFloat(state, -glm::pi<float>(), glm::pi<float>());
+	const vec3 s(randomFloat(state, 0.5f, 1.5f));
+
+	return glm::scale(glm::rotate(glm::translate(mat4(1.0f), t), angle, glm::normalize(axis)), s);
+}
+
+// A full tree is far too wide at MAX_NODE_LEVEL levels, so only the first child of every node keeps branching.
+// The result has every level populated, long parent chains and many nodes per level
+static void generateHierarchy(Scene &scene, uint32_t numLevels, uint32_t numChildren)
+{
+	uint32_t state = 12345;
+
+	const int root = addNode(scene, -1, 0);
+	scene.localTransform[root] = randomTransform(state);
+
+	std::vector<int> parents = {root};
+
+	for (uint32_t level = 1; level < numLevels; level++)
+	{
+		std::vector<int> nodes;
+
+		for (size_t p = 0; p != parents.size(); p++)
+		{
+			const uint32_t count = (p == 0 || level + 2 >= numLevels) ? numChildren : 1;
+
+			for (uint32_t i = 0; i != count; i++)
+			{
+				const int node = addNode(scene, parents[p], (int)level);
+				scene.localTransform[node] = randomTransform(state);
+				nodes.push_back(node);
+			}
+		}
+		parents = std::move(nodes);
+	}
+}
+
+static int getDescendant(const Scene &scene, int node, uint32_t depth)
+{
+	for (uint32_t i = 0; i != depth && scene.hierarchy[node].firstChild > -1; i++)
+		node = scene.hierarchy[node].firstChild;
+
+	return node;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t numLevels = MAX_NODE_LEVEL;
+	uint32_t numChildren = 3;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--levels") && i + 1 < argc)
+		{
+			numLevels = (uint32_t)atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--children") && i + 1 < argc)
+		{
+			numChildren = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (numLevels < 1 || numLevels > MAX_NODE_LEVEL || numChildren < 1)
+	{
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	std::unique_ptr<lvk::VulkanContext> vkCtx = std::make_unique<lvk::VulkanContext>(lvk::ContextConfig{}, nullptr);
+
+	lvk::HWDeviceDesc device;
+	bool hasDevice = false;
+
+	for (const lvk::HWDeviceType type : {lvk::HWDeviceType_Discrete, lvk::HWDeviceType_Integrated, lvk::HWDeviceType_Software})
+	{
+		if (vkCtx->queryDevices(type, &device, 1))
+		{
+			hasDevice = true;
+			break;
+		}
+	}
+
+	if (!hasDevice || !vkCtx->initContext(device).isOk())
+	{
+		printf("No Vulkan device\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Vulkan device: %s\n", device.name);
+
+	std::unique_ptr<lvk::IContext> ctx = std::move(vkCtx);
+
+	Scene scene;
+	generateHierarchy(scene, numLevels, numChildren);
+
+	printf("Generated %u nodes, %u levels\n", (uint32_t)scene.hierarchy.size(), numLevels);
+
+	lvk::Holder<lvk::BufferHandle> bufferTransforms = ctx->createBuffer({
+		.usage = lvk::BufferUsageBits_Storage,
+		.storage = lvk::StorageType_Device,
+		.size = scene.globalTransform.size() * sizeof(mat4),
+		.debugName = "Buffer: transforms",
+	});
+
+	bool isValid = true;
+
+	{
+		VKGlobalTransforms11 transforms(ctx, scene, bufferTransforms);
+
+		// the whole hierarchy
+		markAsChanged(scene, 0);
+		isValid = transforms.validate(scene) && isValid;
+
+		// a subtree in the middle of the hierarchy, the rest of the nodes keep their global transforms
+		const int node = getDescendant(scene, 0, numLevels / 2);
+		scene.localTransform[node] = glm::translate(scene.localTransform[node], vec3(1.0f, 2.0f, 3.0f));
+		markAsChanged(scene, node);
+		isValid = transforms.validate(scene) && isValid;
+	}
+
+	printf(isValid ? "Global transforms: OK\n" : "Global transforms: FAILED\n");
+
+	return isValid ? EXIT_SUCCESS : EXIT_FAILURE;
+}